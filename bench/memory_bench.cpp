@@ -0,0 +1,80 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <csignal>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "MemoryHandler.h"
+
+using namespace std;
+
+// compare the per-word PTRACE_PEEKTEXT loop used by the old dump against MemoryHandler::read
+// usage: ./memory_bench [megabytes]
+int main(int argc, char* argv[])
+{
+    size_t megabytes = (argc >= 2 ? stoul(argv[1]) : 64);
+    size_t length = megabytes << 20;
+
+    // the buffer is allocated before fork so it lives at the same address in the child
+    vector<unsigned char> source(length);
+    for (size_t i = 0; i < length; i++) {
+        source[i] = (unsigned char)(i * 131);
+    }
+
+    pid_t child = fork();
+
+    if (child < 0) {
+        cerr << "** [fork] error" << '\n';
+
+        return EXIT_FAILURE;
+    }
+    else if (child == 0) {
+        ptrace(PTRACE_TRACEME, 0, 0, 0);
+        raise(SIGSTOP);
+
+        _exit(EXIT_SUCCESS);
+    }
+
+    int wait_status;
+    waitpid(child, &wait_status, 0);
+    ptrace(PTRACE_SETOPTIONS, child, 0, PTRACE_O_EXITKILL);
+
+    unsigned long address = (unsigned long)source.data();
+    vector<unsigned char> buffer(length);
+
+    auto begin = chrono::steady_clock::now();
+
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        unsigned long code = ptrace(PTRACE_PEEKTEXT, child, address + i, 0);
+
+        *(unsigned long*)(buffer.data() + i) = code;
+    }
+
+    double peek_seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    bool peek_valid = (buffer == source);
+
+    fill(buffer.begin(), buffer.end(), 0);
+
+    MemoryHandler::attach(child);
+
+    begin = chrono::steady_clock::now();
+    size_t n = MemoryHandler::read(address, buffer.data(), length);
+    double bulk_seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    bool bulk_valid = (n == length && buffer == source);
+
+    MemoryHandler::detach();
+
+    kill(child, SIGKILL);
+    waitpid(child, &wait_status, 0);
+
+    cout << fixed << setprecision(1);
+    cout << "size:       " << megabytes << " MB" << '\n';
+    cout << "peektext:   " << setw(10) << (megabytes / peek_seconds) << " MB/s" << (peek_valid ? "" : " (mismatch)") << '\n';
+    cout << "bulk read:  " << setw(10) << (megabytes / bulk_seconds) << " MB/s" << (bulk_valid ? "" : " (mismatch)") << '\n';
+    cout << "speedup:    " << setw(10) << (peek_seconds / bulk_seconds) << "x" << '\n';
+
+    return 0;
+}
@@ -1,15 +1,49 @@
 #pragma once
 
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "FlatMap.h"
+#include "ExpressionHandler.h"
+
 struct Breakpoint {
+    int id;
     unsigned long address;
     unsigned long code;
+    bool enabled;
+    bool internal;
+    unsigned long hits;
+    std::string condition;
+    std::vector<Operation> program;
+    unsigned long ignore;
+    bool trace;
+    std::vector<std::string> collect;
+    std::vector<std::vector<Operation>> collect_programs;
+};
+
+// one tracepoint hit, values follow the collect list of the tracepoint, bit i of valid is set if value i could be read
+struct TraceRecord {
+    static constexpr size_t MAX_VALUES = 4;
+
+    int id;
+    unsigned long address;
+    unsigned char count;
+    unsigned char valid;
+    unsigned long values[MAX_VALUES];
 };
 
 class BreakpointHandler {
 private:
+    static int m_next_id;
+    static int m_next_internal_id;
     static std::vector<Breakpoint> m_breakpoints;
+    static FlatMap<unsigned long, int> m_addresses;
+    static FlatMap<int, int> m_ids;
+    static std::vector<TraceRecord> m_records;
+    static unsigned long m_recorded;
+
+    static size_t apply(std::vector<std::pair<unsigned long, unsigned char>>& patches);
 
 public:
     BreakpointHandler();
@@ -20,10 +54,21 @@ public:
     BreakpointHandler& operator=(BreakpointHandler const& rhs) = delete;
     BreakpointHandler& operator=(BreakpointHandler&& rhs) = delete;
 
-    static void add(unsigned long address, unsigned long code);
-    static void remove(int index);
+    static int add(unsigned long address, unsigned long code, bool internal = false);
+    static void remove(int id);
+    static std::vector<int> insert(std::vector<unsigned long> addresses, bool internal = false);
+    static void erase(std::vector<int> const& ids);
+    static size_t arm(bool armed);
+    static void restore(unsigned long address, unsigned char* buffer, size_t length);
+    static void overlay(unsigned long address, unsigned char* buffer, size_t length);
+    static size_t rebase(std::vector<std::pair<unsigned long, unsigned char>> patches);
     static void clear();
     static int size();
-    static int find(unsigned long address);
-    static Breakpoint get(int index);
+    static Breakpoint* find(unsigned long address);
+    static Breakpoint* get(int id);
+    static std::vector<Breakpoint const*> list();
+
+    static void record(Breakpoint const& breakpoint);
+    static std::vector<TraceRecord> records(size_t count);
+    static unsigned long recorded();
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+// a stopped fork of the program, status is the stop it was taken at and breakpoints are the int3s in its memory with their original code
+struct Checkpoint {
+    int id;
+    pid_t pid;
+    int status;
+    unsigned long address;
+    std::vector<std::pair<unsigned long, unsigned char>> breakpoints;
+};
+
+// the forks share every page with the program until one of them writes it, so a checkpoint costs little more than its page tables
+class CheckpointHandler {
+private:
+    static int m_next_id;
+    static std::vector<Checkpoint> m_checkpoints;
+
+public:
+    CheckpointHandler();
+    ~CheckpointHandler();
+
+    CheckpointHandler(CheckpointHandler const& rhs) = delete;
+    CheckpointHandler(CheckpointHandler&& rhs) = delete;
+    CheckpointHandler& operator=(CheckpointHandler const& rhs) = delete;
+    CheckpointHandler& operator=(CheckpointHandler&& rhs) = delete;
+
+    static pid_t fork(pid_t pid, pid_t tid);
+    static Checkpoint const* take(pid_t pid, pid_t tid, int status);
+    static Checkpoint const* get(int id);
+    static void list();
+    static bool remove(int id);
+    static void clear();
+};
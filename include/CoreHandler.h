@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "types.h"
+
+// an ELF core of a stopped process, the memory goes straight from /proc/<pid>/mem to the file and zero pages are left as holes
+class CoreHandler {
+private:
+    static void note(std::vector<unsigned char>& notes, unsigned int type, void const* data, size_t size);
+    static std::vector<unsigned char> notes(pid_t pid, std::vector<pid_t> const& threads, int signal, std::vector<map_entry_t> const& mappings);
+
+public:
+    CoreHandler();
+    ~CoreHandler();
+
+    CoreHandler(CoreHandler const& rhs) = delete;
+    CoreHandler(CoreHandler&& rhs) = delete;
+    CoreHandler& operator=(CoreHandler const& rhs) = delete;
+    CoreHandler& operator=(CoreHandler&& rhs) = delete;
+
+    static bool dump(pid_t pid, std::vector<pid_t> const& threads, int signal, std::string path);
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <capstone/capstone.h>
+
+struct Instruction {
+    unsigned long address;
+    unsigned short size;
+    unsigned char bytes[16];
+    std::string mnemonic;
+    std::string op_str;
+};
+
+class DisassembleHandler {
+private:
+    // structure of arrays, offsets are relative to the start of .text and strings index the pool
+    struct Block {
+        unsigned long end;
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned char> sizes;
+        std::vector<unsigned int> mnemonics;
+        std::vector<unsigned int> operands;
+        std::list<unsigned long>::iterator lru;
+    };
+
+    static csh m_handle;
+    static cs_insn* m_insn;
+    static unsigned char const* m_code;
+    static std::vector<unsigned char> m_patched;
+    static unsigned long m_begin;
+    static unsigned long m_end;
+    static size_t m_budget;
+    static size_t m_usage;
+    static std::map<unsigned long, Block> m_blocks;
+    static std::list<unsigned long> m_lru;
+    static std::vector<std::string> m_strings;
+    static std::unordered_map<std::string, unsigned int> m_string_index;
+    static size_t m_string_usage;
+
+    static unsigned int intern(char const* str);
+    static size_t footprint(Block const& block);
+    static Block* find(unsigned long address, size_t& index);
+    static Block* decode(unsigned long address);
+    static void evict();
+    static void clear();
+
+public:
+    DisassembleHandler();
+    ~DisassembleHandler();
+
+    DisassembleHandler(DisassembleHandler const& rhs) = delete;
+    DisassembleHandler(DisassembleHandler&& rhs) = delete;
+    DisassembleHandler& operator=(DisassembleHandler const& rhs) = delete;
+    DisassembleHandler& operator=(DisassembleHandler&& rhs) = delete;
+
+    static bool load(unsigned char const* code, unsigned long begin, unsigned long end);
+    static void unload();
+    static void set_budget(size_t budget);
+    static bool contains(unsigned long address);
+    static std::vector<Instruction> disassemble(unsigned long address, size_t count);
+    static void patch(unsigned long address, unsigned char const* bytes, size_t length);
+};
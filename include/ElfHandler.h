@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <elf.h>
+
+struct Section {
+    std::string_view name;
+    Elf64_Shdr const* header;
+    unsigned char const* data;
+};
+
+struct SymbolTable {
+    Elf64_Sym const* symbols;
+    size_t count;
+    char const* strings;
+    size_t strings_size;
+};
+
+// every accessor returns a view into the read-only mapping, valid until unload()
+// addresses are the link-time ones of the file, bias is what the loader added to them in the process
+class ElfHandler {
+private:
+    static int m_fd;
+    static unsigned char const* m_data;
+    static size_t m_size;
+    static std::vector<Section> m_sections;
+    static std::vector<Elf64_Phdr const*> m_segments;
+    static unsigned long m_bias;
+
+    static bool in_bounds(size_t offset, size_t size);
+
+public:
+    ElfHandler();
+    ~ElfHandler();
+
+    ElfHandler(ElfHandler const& rhs) = delete;
+    ElfHandler(ElfHandler&& rhs) = delete;
+    ElfHandler& operator=(ElfHandler const& rhs) = delete;
+    ElfHandler& operator=(ElfHandler&& rhs) = delete;
+
+    static bool load(std::string path);
+    static void unload();
+    static bool loaded();
+    static void relocate(unsigned long bias);
+    static unsigned long bias();
+
+    static Elf64_Ehdr const* header();
+    static std::vector<Section> const& sections();
+    static std::vector<Elf64_Phdr const*> const& segments();
+    static Section const* section(std::string_view name);
+    static SymbolTable symbols(std::string_view name);
+    static Elf64_Phdr const* segment(unsigned long address);
+    static unsigned char const* data(unsigned long address, size_t length);
+    static std::string build_id();
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum OPCODE {
+    OP_PUSH,
+    OP_REGISTER,
+    OP_LOAD,
+    OP_NEG,
+    OP_NOT,
+    OP_COMPLEMENT,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_ADD,
+    OP_SUB,
+    OP_SHL,
+    OP_SHR,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_XOR,
+    OP_OR,
+    OP_BOOL,
+    OP_JZ,
+    OP_JNZ
+};
+
+// OP_REGISTER: operand is the user_regs_struct offset, shift and mask select the sub-register
+// OP_LOAD: pops an address, width is the number of bytes read
+// OP_JZ / OP_JNZ: && and || jump to operand with 0 / 1 on the stack when the left side decides, otherwise pop it and go on
+struct Operation {
+    OPCODE opcode;
+    unsigned char width;
+    unsigned char shift;
+    unsigned long mask;
+    unsigned long operand;
+};
+
+// expressions are compiled once to a postfix program and evaluated against the cached registers on every stop
+class ExpressionHandler {
+private:
+    static constexpr size_t STACK_SIZE = 64;
+
+    static std::string m_source;
+    static size_t m_position;
+    static size_t m_depth;
+    static size_t m_max_depth;
+    static std::vector<Operation>* m_program;
+
+    static void skip();
+    static bool accept(std::string token);
+    static void emit(Operation operation);
+    static bool binary(int level);
+    static bool unary();
+    static bool primary();
+
+public:
+    ExpressionHandler();
+    ~ExpressionHandler();
+
+    ExpressionHandler(ExpressionHandler const& rhs) = delete;
+    ExpressionHandler(ExpressionHandler&& rhs) = delete;
+    ExpressionHandler& operator=(ExpressionHandler const& rhs) = delete;
+    ExpressionHandler& operator=(ExpressionHandler&& rhs) = delete;
+
+    static bool compile(std::string source, std::vector<Operation>& program);
+    static bool evaluate(std::vector<Operation> const& program, unsigned long& result);
+};
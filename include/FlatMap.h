@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// open addressing with linear probing for integer keys, deletions shift the probe chain back so no tombstones build up
+template <typename Key, typename Value>
+class FlatMap {
+private:
+    struct Bucket {
+        Key key;
+        Value value;
+        bool used;
+    };
+
+    std::vector<Bucket> m_buckets;
+    size_t m_size;
+
+    size_t slot(Key key) const
+    {
+        unsigned long hash = (unsigned long)key * 0x9e3779b97f4a7c15UL;
+
+        return (hash ^ (hash >> 29)) & (this->m_buckets.size() - 1);
+    }
+
+    size_t locate(Key key) const
+    {
+        if (this->m_size == 0) return this->m_buckets.size();
+
+        size_t i = this->slot(key);
+
+        while (this->m_buckets[i].used) {
+            if (this->m_buckets[i].key == key) return i;
+
+            i = (i + 1) & (this->m_buckets.size() - 1);
+        }
+
+        return this->m_buckets.size();
+    }
+
+    void grow()
+    {
+        std::vector<Bucket> buckets(this->m_buckets.empty() ? 16 : this->m_buckets.size() * 2);
+        buckets.swap(this->m_buckets);
+
+        this->m_size = 0;
+
+        for (auto& bucket : buckets) {
+            if (bucket.used) this->insert(bucket.key, bucket.value);
+        }
+    }
+
+public:
+    FlatMap() : m_size(0)
+    {
+    }
+
+    void insert(Key key, Value value)
+    {
+        if ((this->m_size + 1) * 2 > this->m_buckets.size()) this->grow();
+
+        size_t i = this->slot(key);
+
+        while (this->m_buckets[i].used && this->m_buckets[i].key != key) {
+            i = (i + 1) & (this->m_buckets.size() - 1);
+        }
+
+        if (!this->m_buckets[i].used) this->m_size += 1;
+
+        this->m_buckets[i] = Bucket { key, value, true };
+    }
+
+    Value* find(Key key)
+    {
+        size_t i = this->locate(key);
+
+        if (i == this->m_buckets.size()) return nullptr;
+
+        return &(this->m_buckets[i].value);
+    }
+
+    void erase(Key key)
+    {
+        size_t hole = this->locate(key);
+
+        if (hole == this->m_buckets.size()) return;
+
+        size_t mask = this->m_buckets.size() - 1;
+        size_t i = hole;
+
+        this->m_buckets[hole].used = false;
+        this->m_size -= 1;
+
+        // move later members of the chain into the hole when their home slot does not lie between hole and them
+        while (true) {
+            i = (i + 1) & mask;
+
+            if (!this->m_buckets[i].used) break;
+
+            size_t home = this->slot(this->m_buckets[i].key);
+
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                this->m_buckets[hole] = this->m_buckets[i];
+                this->m_buckets[i].used = false;
+                hole = i;
+            }
+        }
+    }
+
+    void clear()
+    {
+        this->m_buckets.clear();
+        this->m_size = 0;
+    }
+
+    size_t size() const
+    {
+        return this->m_size;
+    }
+};
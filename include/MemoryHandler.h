@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <sys/types.h>
+
+class MemoryHandler {
+private:
+    static pid_t m_pid;
+    static int m_fd;
+    static unsigned long m_page_size;
+    static size_t m_page_limit;
+    static std::unordered_map<unsigned long, std::vector<unsigned char>> m_pages;
+
+    static size_t raw_read(unsigned long address, void* buffer, size_t length);
+    static size_t raw_write(unsigned long address, void const* buffer, size_t length);
+    static size_t fill(unsigned long page, size_t count);
+
+public:
+    MemoryHandler();
+    ~MemoryHandler();
+
+    MemoryHandler(MemoryHandler const& rhs) = delete;
+    MemoryHandler(MemoryHandler&& rhs) = delete;
+    MemoryHandler& operator=(MemoryHandler const& rhs) = delete;
+    MemoryHandler& operator=(MemoryHandler&& rhs) = delete;
+
+    static void attach(pid_t pid);
+    static void detach();
+    static void invalidate();
+    static size_t read(unsigned long address, void* buffer, size_t length);
+    static size_t write(unsigned long address, void const* buffer, size_t length);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "types.h"
+
+// samples are stored raw during profiling and only symbolized in report(), so nothing but the unwinding happens while the tracee is stopped
+class ProfileHandler {
+private:
+    static std::map<range_t, map_entry_t> m_maps;
+    static std::vector<unsigned long> m_frames;
+    static std::vector<unsigned int> m_depths;
+    static std::vector<unsigned long> m_stop_times;
+    static std::set<pid_t> m_threads;
+
+    static std::string label(unsigned long address);
+
+public:
+    ProfileHandler();
+    ~ProfileHandler();
+
+    ProfileHandler(ProfileHandler const& rhs) = delete;
+    ProfileHandler(ProfileHandler&& rhs) = delete;
+    ProfileHandler& operator=(ProfileHandler const& rhs) = delete;
+    ProfileHandler& operator=(ProfileHandler&& rhs) = delete;
+
+    static void start(pid_t pid);
+    static void sample(pid_t tid, std::vector<unsigned long> const& stack);
+    static void stopped(unsigned long stop_time);
+    static size_t samples();
+    static void report(double elapsed, std::string path);
+};
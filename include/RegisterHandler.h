@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "RegisterTable.h"
+
+class RegisterHandler {
+private:
+    static pid_t m_pid;
+    static bool m_valid;
+    static bool m_dirty;
+    static struct user_regs_struct m_regs;
+    static bool m_fpregs_valid;
+    static struct user_fpregs_struct m_fpregs;
+    static bool m_xstate_valid;
+    static std::vector<unsigned char> m_xstate;
+
+public:
+    RegisterHandler();
+    ~RegisterHandler();
+
+    RegisterHandler(RegisterHandler const& rhs) = delete;
+    RegisterHandler(RegisterHandler&& rhs) = delete;
+    RegisterHandler& operator=(RegisterHandler const& rhs) = delete;
+    RegisterHandler& operator=(RegisterHandler&& rhs) = delete;
+
+    static void attach(pid_t pid);
+    static void detach();
+    static void invalidate();
+    static bool flush();
+    static struct user_regs_struct const& get();
+    static struct user_regs_struct& modify();
+    static unsigned long read(RegisterDescriptor const& reg);
+    static void write(RegisterDescriptor const& reg, unsigned long value);
+    static struct user_fpregs_struct const& fpregs();
+    static std::vector<unsigned char> const& xstate();
+};
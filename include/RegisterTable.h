@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <sys/user.h>
+
+struct RegisterDescriptor {
+    std::string_view name;
+    size_t offset;
+    unsigned char width;
+    unsigned char shift;
+    unsigned long mask;
+};
+
+// width in bytes, shift in bits inside the 64-bit user_regs_struct field that holds the register
+constexpr RegisterDescriptor make_register(std::string_view name, size_t offset, unsigned char width, unsigned char shift = 0)
+{
+    return RegisterDescriptor {
+        name,
+        offset,
+        width,
+        shift,
+        (width == 8 ? ~0UL : ((1UL << (width * 8)) - 1))
+    };
+}
+
+#define REG(field) offsetof(struct user_regs_struct, field)
+
+constexpr std::array<RegisterDescriptor, 81> register_table{{
+    make_register("rax", REG(rax), 8), make_register("rbx", REG(rbx), 8),
+    make_register("rcx", REG(rcx), 8), make_register("rdx", REG(rdx), 8),
+    make_register("rsi", REG(rsi), 8), make_register("rdi", REG(rdi), 8),
+    make_register("rbp", REG(rbp), 8), make_register("rsp", REG(rsp), 8),
+    make_register("r8", REG(r8), 8), make_register("r9", REG(r9), 8),
+    make_register("r10", REG(r10), 8), make_register("r11", REG(r11), 8),
+    make_register("r12", REG(r12), 8), make_register("r13", REG(r13), 8),
+    make_register("r14", REG(r14), 8), make_register("r15", REG(r15), 8),
+    make_register("rip", REG(rip), 8), make_register("orig_rax", REG(orig_rax), 8),
+    make_register("eflags", REG(eflags), 8), make_register("flags", REG(eflags), 8),
+    make_register("rflags", REG(eflags), 8),
+    make_register("cs", REG(cs), 8), make_register("ss", REG(ss), 8),
+    make_register("ds", REG(ds), 8), make_register("es", REG(es), 8),
+    make_register("fs", REG(fs), 8), make_register("gs", REG(gs), 8),
+    make_register("fs_base", REG(fs_base), 8), make_register("gs_base", REG(gs_base), 8),
+
+    make_register("eax", REG(rax), 4), make_register("ebx", REG(rbx), 4),
+    make_register("ecx", REG(rcx), 4), make_register("edx", REG(rdx), 4),
+    make_register("esi", REG(rsi), 4), make_register("edi", REG(rdi), 4),
+    make_register("ebp", REG(rbp), 4), make_register("esp", REG(rsp), 4),
+    make_register("r8d", REG(r8), 4), make_register("r9d", REG(r9), 4),
+    make_register("r10d", REG(r10), 4), make_register("r11d", REG(r11), 4),
+    make_register("r12d", REG(r12), 4), make_register("r13d", REG(r13), 4),
+    make_register("r14d", REG(r14), 4), make_register("r15d", REG(r15), 4),
+
+    make_register("ax", REG(rax), 2), make_register("bx", REG(rbx), 2),
+    make_register("cx", REG(rcx), 2), make_register("dx", REG(rdx), 2),
+    make_register("si", REG(rsi), 2), make_register("di", REG(rdi), 2),
+    make_register("bp", REG(rbp), 2), make_register("sp", REG(rsp), 2),
+    make_register("r8w", REG(r8), 2), make_register("r9w", REG(r9), 2),
+    make_register("r10w", REG(r10), 2), make_register("r11w", REG(r11), 2),
+    make_register("r12w", REG(r12), 2), make_register("r13w", REG(r13), 2),
+    make_register("r14w", REG(r14), 2), make_register("r15w", REG(r15), 2),
+
+    make_register("al", REG(rax), 1), make_register("bl", REG(rbx), 1),
+    make_register("cl", REG(rcx), 1), make_register("dl", REG(rdx), 1),
+    make_register("sil", REG(rsi), 1), make_register("dil", REG(rdi), 1),
+    make_register("bpl", REG(rbp), 1), make_register("spl", REG(rsp), 1),
+    make_register("r8b", REG(r8), 1), make_register("r9b", REG(r9), 1),
+    make_register("r10b", REG(r10), 1), make_register("r11b", REG(r11), 1),
+    make_register("r12b", REG(r12), 1), make_register("r13b", REG(r13), 1),
+    make_register("r14b", REG(r14), 1), make_register("r15b", REG(r15), 1),
+
+    make_register("ah", REG(rax), 1, 8), make_register("bh", REG(rbx), 1, 8),
+    make_register("ch", REG(rcx), 1, 8), make_register("dh", REG(rdx), 1, 8)
+}};
+
+#undef REG
+
+// seeded FNV-1a folded to 9 bits, the seed was searched offline so every name above gets its own slot
+constexpr uint32_t REGISTER_HASH_SEED = 0x2e3;
+constexpr size_t REGISTER_HASH_SIZE = 512;
+
+constexpr size_t register_hash(std::string_view name)
+{
+    uint32_t hash = REGISTER_HASH_SEED;
+
+    for (auto c : name) {
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    }
+
+    return (hash ^ (hash >> 15)) & (REGISTER_HASH_SIZE - 1);
+}
+
+constexpr std::array<unsigned char, REGISTER_HASH_SIZE> register_slots = [] {
+    std::array<unsigned char, REGISTER_HASH_SIZE> slots{};
+
+    for (size_t i = 0; i < slots.size(); i++) {
+        slots[i] = 0xff;
+    }
+
+    for (size_t i = 0; i < register_table.size(); i++) {
+        slots[register_hash(register_table[i].name)] = i;
+    }
+
+    return slots;
+}();
+
+constexpr bool register_hash_is_perfect()
+{
+    for (size_t i = 0; i < register_table.size(); i++) {
+        if (register_slots[register_hash(register_table[i].name)] != i) return false;
+    }
+
+    return true;
+}
+
+static_assert(register_hash_is_perfect(), "register names collide, pick another REGISTER_HASH_SEED");
+
+// one hash and one string compare, NULL if the name is not a register
+constexpr RegisterDescriptor const* find_register(std::string_view name)
+{
+    unsigned char slot = register_slots[register_hash(name)];
+
+    if (slot == 0xff || register_table[slot].name != name) return nullptr;
+
+    return &register_table[slot];
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "types.h"
+
+// a piece of one mapping read and scanned by one worker, matches are kept until find() has printed the chunks before it
+struct SearchChunk {
+    map_entry_t const* mapping;
+    unsigned long begin;
+    unsigned long end;
+    bool done;
+    std::vector<unsigned long> matches;
+};
+
+// patterns are compiled to bytes and a mask, a byte matches if (memory & mask) == pattern
+// the scan compares two fully known bytes of the pattern 16 or 32 positions at a time and verifies the candidates
+class SearchHandler {
+private:
+    static std::vector<unsigned char> m_pattern;
+    static std::vector<unsigned char> m_mask;
+    static size_t m_first;
+    static size_t m_last;
+    static bool m_anchored;
+    static bool m_exact;
+
+    static bool verify(unsigned char const* data);
+    static void scan_scalar(unsigned char const* data, size_t length, size_t begin, size_t limit, std::vector<unsigned long>& offsets);
+    static void scan_sse2(unsigned char const* data, size_t length, size_t limit, std::vector<unsigned long>& offsets);
+    static void scan_avx2(unsigned char const* data, size_t length, size_t limit, std::vector<unsigned long>& offsets);
+
+public:
+    SearchHandler();
+    ~SearchHandler();
+
+    SearchHandler(SearchHandler const& rhs) = delete;
+    SearchHandler(SearchHandler&& rhs) = delete;
+    SearchHandler& operator=(SearchHandler const& rhs) = delete;
+    SearchHandler& operator=(SearchHandler&& rhs) = delete;
+
+    static bool compile(std::string source);
+    static void find(pid_t pid, std::string region, size_t limit);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "types.h"
+
+// a page is kept as a bitmap of its non-zero words followed by those words, a zero page is not kept at all (NULL)
+typedef std::shared_ptr<std::vector<unsigned long> const> PageCopy;
+
+// pages a snapshot has in common with the one before it are shared, only the soft-dirty ones are copied again
+struct Snapshot {
+    int id;
+    std::vector<map_entry_t> mappings;
+    std::map<unsigned long, PageCopy> pages;
+    size_t copied;
+    size_t stored;
+};
+
+class SnapshotHandler {
+private:
+    static pid_t m_pid;
+    static int m_next_id;
+    static unsigned long m_page_size;
+    static bool m_soft_dirty;
+    static int m_baseline;
+    static std::vector<Snapshot> m_snapshots;
+
+    static bool probe();
+    static bool tracked();
+    static std::vector<map_entry_t> mappings();
+    static std::vector<unsigned long> pagemap(map_entry_t const& mapping);
+    static bool clear_refs();
+    static size_t read(unsigned long address, unsigned char* buffer, size_t length);
+    static PageCopy compress(unsigned char const* page);
+    static void decompress(PageCopy const& copy, unsigned char* page);
+    static size_t compare(unsigned char const* lhs, unsigned char const* rhs, size_t offset);
+
+public:
+    SnapshotHandler();
+    ~SnapshotHandler();
+
+    SnapshotHandler(SnapshotHandler const& rhs) = delete;
+    SnapshotHandler(SnapshotHandler&& rhs) = delete;
+    SnapshotHandler& operator=(SnapshotHandler const& rhs) = delete;
+    SnapshotHandler& operator=(SnapshotHandler&& rhs) = delete;
+
+    static void attach(pid_t pid);
+    static void detach();
+    static void take();
+    static void list();
+    static bool remove(int id);
+    static void diff(int id);
+};
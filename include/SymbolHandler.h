@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct Symbol {
+    unsigned long address;
+    unsigned long size;
+    std::string_view name;
+    unsigned char type;
+};
+
+// names are views into the mapped string tables of ElfHandler, valid until unload()
+class SymbolHandler {
+private:
+    static std::vector<Symbol> m_symbols;
+    static std::vector<std::pair<unsigned int, unsigned int>> m_names;
+
+    static void add(std::string_view table);
+
+public:
+    SymbolHandler();
+    ~SymbolHandler();
+
+    SymbolHandler(SymbolHandler const& rhs) = delete;
+    SymbolHandler(SymbolHandler&& rhs) = delete;
+    SymbolHandler& operator=(SymbolHandler const& rhs) = delete;
+    SymbolHandler& operator=(SymbolHandler&& rhs) = delete;
+
+    static void load();
+    static void unload();
+    static int size();
+
+    static Symbol const* find(unsigned long address);
+    static Symbol const* find(std::string_view name);
+    static std::vector<Symbol const*> match(std::string pattern);
+    static std::string symbolize(unsigned long address);
+    static bool resolve(std::string expression, unsigned long& address);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+// times are CLOCK_MONOTONIC nanoseconds taken at the seccomp stop and at the syscall-exit stop
+struct SyscallRecord {
+    pid_t tid;
+    long number;
+    unsigned long args[6];
+    long result;
+    unsigned long begin;
+    unsigned long duration;
+};
+
+// bucket i counts the calls that took less than 2^i microseconds (and at least 2^(i - 1))
+struct SyscallStat {
+    static constexpr size_t BUCKETS = 24;
+
+    unsigned long count;
+    unsigned long errors;
+    unsigned long total;
+    unsigned long min;
+    unsigned long max;
+    unsigned long buckets[BUCKETS];
+};
+
+// the filter only sends the selected system calls to us, all others never leave the kernel
+class SyscallHandler {
+private:
+    static std::vector<long> m_selected;
+    static std::unordered_map<pid_t, SyscallRecord> m_inflight;
+    static std::vector<SyscallRecord> m_records;
+    static unsigned long m_recorded;
+    static std::map<long, SyscallStat> m_stats;
+
+public:
+    SyscallHandler();
+    ~SyscallHandler();
+
+    SyscallHandler(SyscallHandler const& rhs) = delete;
+    SyscallHandler(SyscallHandler&& rhs) = delete;
+    SyscallHandler& operator=(SyscallHandler const& rhs) = delete;
+    SyscallHandler& operator=(SyscallHandler&& rhs) = delete;
+
+    static long number(std::string_view name);
+    static std::string name(long number);
+
+    static bool select(std::vector<std::string> const& names);
+    static std::vector<long> const& selected();
+    static bool install();
+
+    static void enter(pid_t tid, struct user_regs_struct const& regs);
+    static void leave(pid_t tid, struct user_regs_struct const& regs);
+    static bool inflight(pid_t tid);
+    static void clear();
+
+    static void report();
+    static void log(size_t count);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <sys/types.h>
+
+#include "types.h"
+
+// status is a stop that was waited for but not reported yet, it is handed out again by pending()
+struct Thread {
+    pid_t tid;
+    THREAD_STATE state;
+    bool pending;
+    int status;
+};
+
+// all-stop: every thread is stopped while one is inspected and resumed with it
+// non-stop: only the thread that stopped is held, the others keep running
+class ThreadHandler {
+private:
+    static std::map<pid_t, Thread> m_threads;
+    static pid_t m_current;
+    static bool m_non_stop;
+
+public:
+    ThreadHandler();
+    ~ThreadHandler();
+
+    ThreadHandler(ThreadHandler const& rhs) = delete;
+    ThreadHandler(ThreadHandler&& rhs) = delete;
+    ThreadHandler& operator=(ThreadHandler const& rhs) = delete;
+    ThreadHandler& operator=(ThreadHandler&& rhs) = delete;
+
+    static void clear();
+    static Thread* add(pid_t tid, THREAD_STATE state);
+    static void remove(pid_t tid);
+    static Thread* get(pid_t tid);
+    static std::vector<Thread const*> list();
+    static size_t size();
+
+    static pid_t current();
+    static void select(pid_t tid);
+    static bool non_stop();
+    static void set_non_stop(bool non_stop);
+
+    static Thread* pending();
+    static void stop_others();
+    static void resume_others();
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/user.h>
+
+#include "RegisterTable.h"
+
+// file layout: "SDBTRACE", uint32 version, uint32 register count n, n names of 16 bytes,
+// since version 2 the uint64 load bias of the program, then one record per instruction: uint64 rip followed by n uint64 register values
+struct TraceHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int count;
+};
+
+class TraceHandler {
+private:
+    static std::ofstream m_file;
+    static std::vector<RegisterDescriptor const*> m_registers;
+    static std::vector<unsigned long> m_buffer;
+    static size_t m_used;
+    static unsigned long m_count;
+
+    static void drain();
+
+public:
+    static constexpr size_t NAME_SIZE = 16;
+
+    TraceHandler();
+    ~TraceHandler();
+
+    TraceHandler(TraceHandler const& rhs) = delete;
+    TraceHandler(TraceHandler&& rhs) = delete;
+    TraceHandler& operator=(TraceHandler const& rhs) = delete;
+    TraceHandler& operator=(TraceHandler&& rhs) = delete;
+
+    static bool open(std::string path, std::vector<RegisterDescriptor const*> const& registers, unsigned long bias);
+    static void record(struct user_regs_struct const& regs);
+    static unsigned long close();
+};
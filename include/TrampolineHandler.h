@@ -0,0 +1,53 @@
+#pragma once
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include <capstone/capstone.h>
+
+#include "types.h"
+
+class TrampolineHandler {
+private:
+    enum SLOT_TYPE {
+        SLOT_NONE,
+        SLOT_COPY,
+        SLOT_CALL
+    };
+
+    struct Slot {
+        SLOT_TYPE type;
+        unsigned long address;
+        unsigned long target;
+        std::vector<std::pair<unsigned long, unsigned long>> exits;
+    };
+
+    static pid_t m_pid;
+    static csh m_handle;
+    static unsigned long m_near;
+    static unsigned long m_scratch;
+    static bool m_failed;
+    static std::vector<unsigned long> m_owners;
+    static std::vector<unsigned long> m_free;
+    static std::unordered_map<unsigned long, Slot> m_slots;
+
+    static bool allocate();
+    static Slot build(unsigned long address, unsigned char code);
+
+public:
+    TrampolineHandler();
+    ~TrampolineHandler();
+
+    TrampolineHandler(TrampolineHandler const& rhs) = delete;
+    TrampolineHandler(TrampolineHandler&& rhs) = delete;
+    TrampolineHandler& operator=(TrampolineHandler const& rhs) = delete;
+    TrampolineHandler& operator=(TrampolineHandler&& rhs) = delete;
+
+    static void attach(pid_t pid, unsigned long near);
+    static void detach();
+    static void select(pid_t pid);
+    static void release(unsigned long address);
+    static DISPLACE_TYPE displace(unsigned long address, unsigned char code);
+    static void fixup();
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+
+// bulk copies between files and the memory of a stopped process, every byte written goes through the breakpoint table
+class TransferHandler {
+private:
+    static bool mapped(pid_t pid, unsigned long address, size_t length);
+    static size_t write(unsigned long address, unsigned char* buffer, size_t length);
+    static void release(unsigned long address, size_t length);
+    static void report(std::string title, size_t length, double seconds);
+
+public:
+    TransferHandler();
+    ~TransferHandler();
+
+    TransferHandler(TransferHandler const& rhs) = delete;
+    TransferHandler(TransferHandler&& rhs) = delete;
+    TransferHandler& operator=(TransferHandler const& rhs) = delete;
+    TransferHandler& operator=(TransferHandler&& rhs) = delete;
+
+    static bool save(pid_t pid, unsigned long address, size_t length, std::string path);
+    static bool load(pid_t pid, unsigned long address, std::string path);
+    static bool patch(pid_t pid, unsigned long address, std::string bytes);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#include "types.h"
+
+// slot is the debug register (0-3) backing the watchpoint, -1 for a software watchpoint checked after every single-step
+struct Watchpoint {
+    int id;
+    unsigned long address;
+    unsigned char length;
+    WATCH_TYPE type;
+    int slot;
+    unsigned long value;
+    unsigned long previous;
+    unsigned long hits;
+};
+
+class WatchpointHandler {
+private:
+    static constexpr int SLOTS = 4;
+
+    static pid_t m_pid;
+    static int m_next_id;
+    static unsigned long m_dr7;
+    static unsigned long m_generation;
+    static std::unordered_map<pid_t, unsigned long> m_synced;
+    static std::vector<Watchpoint> m_watchpoints;
+
+    static bool poke(pid_t tid, int index, unsigned long value);
+    static void publish();
+    static unsigned long load(unsigned long address, unsigned char length);
+
+public:
+    WatchpointHandler();
+    ~WatchpointHandler();
+
+    WatchpointHandler(WatchpointHandler const& rhs) = delete;
+    WatchpointHandler(WatchpointHandler&& rhs) = delete;
+    WatchpointHandler& operator=(WatchpointHandler const& rhs) = delete;
+    WatchpointHandler& operator=(WatchpointHandler&& rhs) = delete;
+
+    static void attach(pid_t pid);
+    static void detach();
+    static void select(pid_t tid);
+    static void sync(pid_t tid);
+    static int add(unsigned long address, unsigned char length, WATCH_TYPE type, bool fallback);
+    static bool remove(int id);
+    static Watchpoint const* get(int id);
+    static std::vector<Watchpoint> const& list();
+    static bool armed();
+    static bool software();
+    static Watchpoint* hit();
+    static Watchpoint* changed();
+};
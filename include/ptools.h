@@ -9,8 +9,11 @@
 
 std::map<std::string, std::string> parse(int argc, char* argv[]);
 std::vector<std::string> prompt(std::string message, std::istream& in);
-void dump_code(unsigned long addr, unsigned long code[], int length = 80);
+void dump_code(unsigned long addr, unsigned char const code[], int length = 80);
 int load_maps(pid_t pid, std::map<range_t, map_entry_t>& loaded);
+long inject_syscall(pid_t pid, long number, std::vector<unsigned long> const& args);
+std::vector<pid_t> list_threads(pid_t pid);
+pid_t thread_group(pid_t tid);
 
 bool operator<(range_t r1, range_t r2);
 std::ostream& operator<<(std::ostream& os, const map_entry_t& rhs);
@@ -10,22 +10,74 @@ enum STATUS {
 
 enum COMMAND_TYPE {
     UNKNOWN,
+    ATTACH,
     BREAK,
+    BREAK_FILE,
+    CHECKPOINT,
+    CONDITION,
     CONT,
+    COUNTS,
     DELETE,
+    DETACH,
+    DIFF,
+    DISABLE,
     DISASM,
     DUMP,
+    ENABLE,
     EXIT,
+    FIND,
+    FINISH,
+    GCORE,
     GET,
     GETREGS,
+    GETFPREGS,
+    HBREAK,
     HELP,
+    IGNORE,
     LIST,
     LOAD,
+    LOADMEM,
+    NEXT,
+    NONSTOP,
+    PATCH,
+    PROFILE,
+    RBREAK,
+    RESTART,
     RUN,
+    SAVEMEM,
+    SECTIONS,
     VMMAP,
     SET,
     SI,
-    START
+    SNAPSHOT,
+    SYMBOLS,
+    SYSCALLS,
+    START,
+    TDUMP,
+    THREAD,
+    THREADS,
+    TPOINT,
+    TRACE,
+    UNTIL,
+    UNWATCH,
+    WATCH
+};
+
+enum WATCH_TYPE {
+    WATCH_EXECUTE,
+    WATCH_WRITE,
+    WATCH_ACCESS
+};
+
+enum THREAD_STATE {
+    THREAD_RUNNING,
+    THREAD_STOPPED
+};
+
+enum DISPLACE_TYPE {
+    NOT_DISPLACED,
+    DISPLACED,
+    EMULATED
 };
 
 typedef struct {
@@ -1,8 +1,22 @@
 #include "BreakpointHandler.h"
 
+#include <algorithm>
+#include <unistd.h>
+
+#include "MemoryHandler.h"
+
 using namespace std;
 
+int BreakpointHandler::m_next_id = 0;
+int BreakpointHandler::m_next_internal_id = -1;
 vector<Breakpoint> BreakpointHandler::m_breakpoints;
+FlatMap<unsigned long, int> BreakpointHandler::m_addresses;
+FlatMap<int, int> BreakpointHandler::m_ids;
+vector<TraceRecord> BreakpointHandler::m_records;
+unsigned long BreakpointHandler::m_recorded = 0;
+
+// tracepoint hits kept in memory, the oldest are overwritten
+static constexpr size_t RECORD_CAPACITY = 1 << 16;
 
 BreakpointHandler::BreakpointHandler()
 {
@@ -14,24 +28,209 @@ BreakpointHandler::~BreakpointHandler()
     BreakpointHandler::m_breakpoints.shrink_to_fit();
 }
 
-void BreakpointHandler::add(unsigned long address, unsigned long code)
+// ids are never reused, so they stay valid for scripts after other breakpoints are removed
+// internal breakpoints count down from -1 and never take an id the user would see
+int BreakpointHandler::add(unsigned long address, unsigned long code, bool internal)
 {
+    int id = (internal ? BreakpointHandler::m_next_internal_id-- : BreakpointHandler::m_next_id++);
+
+    BreakpointHandler::m_addresses.insert(address, BreakpointHandler::m_breakpoints.size());
+    BreakpointHandler::m_ids.insert(id, BreakpointHandler::m_breakpoints.size());
+
     BreakpointHandler::m_breakpoints.push_back(
         Breakpoint {
+            .id = id,
             .address = address,
-            .code = code
+            .code = code,
+            .enabled = true,
+            .internal = internal,
+            .hits = 0,
+            .condition = "",
+            .program = {},
+            .ignore = 0,
+            .trace = false,
+            .collect = {},
+            .collect_programs = {}
         }
     );
+
+    return id;
 }
 
-void BreakpointHandler::remove(int index)
+// the last breakpoint takes the freed place, both indexes are updated for it
+void BreakpointHandler::remove(int id)
 {
-    BreakpointHandler::m_breakpoints.erase(BreakpointHandler::m_breakpoints.begin() + index);
+    int* index = BreakpointHandler::m_ids.find(id);
+
+    if (index == nullptr) return;
+
+    int target = *index;
+    Breakpoint& last = BreakpointHandler::m_breakpoints.back();
+
+    BreakpointHandler::m_addresses.erase(BreakpointHandler::m_breakpoints[target].address);
+    BreakpointHandler::m_ids.erase(id);
+
+    if (target != (int)BreakpointHandler::m_breakpoints.size() - 1) {
+        BreakpointHandler::m_addresses.insert(last.address, target);
+        BreakpointHandler::m_ids.insert(last.id, target);
+
+        BreakpointHandler::m_breakpoints[target] = move(last);
+    }
+
+    BreakpointHandler::m_breakpoints.pop_back();
+}
+
+// write every patch byte, one read and one write per touched page instead of a peek and a poke per address
+size_t BreakpointHandler::apply(vector<pair<unsigned long, unsigned char>>& patches)
+{
+    static unsigned long page_size = sysconf(_SC_PAGESIZE);
+
+    sort(patches.begin(), patches.end());
+
+    size_t total = 0;
+    vector<unsigned char> buffer;
+
+    for (size_t i = 0, j = 0; i < patches.size(); i = j) {
+        unsigned long page = patches[i].first & ~(page_size - 1);
+
+        for (j = i; j < patches.size() && (patches[j].first & ~(page_size - 1)) == page; j++);
+
+        unsigned long begin = patches[i].first;
+        size_t length = patches[j - 1].first - begin + 1;
+
+        buffer.resize(length);
+
+        if (MemoryHandler::read(begin, buffer.data(), length) != length) continue;
+
+        for (size_t k = i; k < j; k++) {
+            buffer[patches[k].first - begin] = patches[k].second;
+        }
+
+        if (MemoryHandler::write(begin, buffer.data(), length) != length) continue;
+
+        total += j - i;
+    }
+
+    return total;
+}
+
+// arm all new addresses at once, duplicates and already known addresses are skipped, returns the ids of the new breakpoints
+vector<int> BreakpointHandler::insert(vector<unsigned long> addresses, bool internal)
+{
+    vector<int> ids;
+    vector<pair<unsigned long, unsigned char>> patches;
+
+    sort(addresses.begin(), addresses.end());
+    addresses.erase(unique(addresses.begin(), addresses.end()), addresses.end());
+
+    for (auto address : addresses) {
+        unsigned char code = 0;
+
+        if (BreakpointHandler::find(address) != NULL || MemoryHandler::read(address, &code, 1) != 1) continue;
+
+        patches.push_back(make_pair(address, 0xcc));
+        ids.push_back(BreakpointHandler::add(address, code, internal));
+    }
+
+    if (BreakpointHandler::apply(patches) != patches.size()) {
+        // roll back whatever could not be armed so the table never claims a trap that is not in memory
+        for (auto it = ids.begin(); it != ids.end();) {
+            Breakpoint* breakpoint = BreakpointHandler::get(*it);
+            unsigned char code = 0;
+
+            if (MemoryHandler::read(breakpoint->address, &code, 1) != 1 || code != 0xcc) {
+                BreakpointHandler::remove(*it);
+                it = ids.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+    }
+
+    return ids;
+}
+
+// restore the original bytes of every enabled breakpoint in one pass, then forget them
+void BreakpointHandler::erase(vector<int> const& ids)
+{
+    vector<pair<unsigned long, unsigned char>> patches;
+
+    for (auto id : ids) {
+        Breakpoint* breakpoint = BreakpointHandler::get(id);
+
+        if (breakpoint != NULL && breakpoint->enabled) {
+            patches.push_back(make_pair(breakpoint->address, (unsigned char)breakpoint->code));
+        }
+    }
+
+    BreakpointHandler::apply(patches);
+
+    for (auto id : ids) {
+        BreakpointHandler::remove(id);
+    }
+}
+
+// write the int3 (armed) or the original byte of every enabled breakpoint, the table itself stays as it is
+size_t BreakpointHandler::arm(bool armed)
+{
+    vector<pair<unsigned long, unsigned char>> patches;
+
+    for (auto& breakpoint : BreakpointHandler::m_breakpoints) {
+        if (breakpoint.enabled) {
+            patches.push_back(make_pair(breakpoint.address, (unsigned char)(armed ? 0xcc : breakpoint.code)));
+        }
+    }
+
+    return BreakpointHandler::apply(patches);
+}
+
+// puts the original code back into a copy of [address, address + length), for views of memory that should not show our int3s
+void BreakpointHandler::restore(unsigned long address, unsigned char* buffer, size_t length)
+{
+    for (auto& breakpoint : BreakpointHandler::m_breakpoints) {
+        if (breakpoint.enabled && breakpoint.address - address < length) {
+            buffer[breakpoint.address - address] = breakpoint.code;
+        }
+    }
+}
+
+// the other way around, new bytes for memory become the original code of the breakpoints they cover and enabled ones keep their int3
+void BreakpointHandler::overlay(unsigned long address, unsigned char* buffer, size_t length)
+{
+    for (auto& breakpoint : BreakpointHandler::m_breakpoints) {
+        if (breakpoint.address - address < length) {
+            breakpoint.code = buffer[breakpoint.address - address];
+
+            if (breakpoint.enabled) {
+                buffer[breakpoint.address - address] = 0xcc;
+            }
+        }
+    }
+}
+
+// a copy of the process made earlier still holds the int3s it had then, given as (address, original code)
+// they are taken out, every breakpoint takes its original code from that memory and the enabled ones are armed again
+size_t BreakpointHandler::rebase(vector<pair<unsigned long, unsigned char>> patches)
+{
+    BreakpointHandler::apply(patches);
+
+    for (auto& breakpoint : BreakpointHandler::m_breakpoints) {
+        unsigned char code = 0;
+
+        if (MemoryHandler::read(breakpoint.address, &code, 1) == 1) {
+            breakpoint.code = code;
+        }
+    }
+
+    return BreakpointHandler::arm(true);
 }
 
 void BreakpointHandler::clear()
 {
     BreakpointHandler::m_breakpoints.clear();
+    BreakpointHandler::m_addresses.clear();
+    BreakpointHandler::m_ids.clear();
 }
 
 int BreakpointHandler::size()
@@ -39,16 +238,82 @@ int BreakpointHandler::size()
     return BreakpointHandler::m_breakpoints.size();
 }
 
-int BreakpointHandler::find(unsigned long address)
+Breakpoint* BreakpointHandler::find(unsigned long address)
+{
+    int* index = BreakpointHandler::m_addresses.find(address);
+
+    if (index == nullptr) return NULL;
+
+    return &BreakpointHandler::m_breakpoints[*index];
+}
+
+Breakpoint* BreakpointHandler::get(int id)
+{
+    int* index = BreakpointHandler::m_ids.find(id);
+
+    if (index == nullptr) return NULL;
+
+    return &BreakpointHandler::m_breakpoints[*index];
+}
+
+// ordered by id, internal breakpoints of next / finish / until are left out
+vector<Breakpoint const*> BreakpointHandler::list()
+{
+    vector<Breakpoint const*> breakpoints;
+
+    for (auto& breakpoint : BreakpointHandler::m_breakpoints) {
+        if (breakpoint.internal) continue;
+
+        breakpoints.push_back(&breakpoint);
+    }
+
+    sort(breakpoints.begin(), breakpoints.end(), [](Breakpoint const* lhs, Breakpoint const* rhs) {
+        return lhs->id < rhs->id;
+    });
+
+    return breakpoints;
+}
+
+// called on the stop path of a tracepoint, nothing but the register cache and the page cache is touched
+void BreakpointHandler::record(Breakpoint const& breakpoint)
 {
-    for (size_t i = 0; i < BreakpointHandler::m_breakpoints.size(); i++) {
-        if (BreakpointHandler::m_breakpoints[i].address == address) return i;
+    if (BreakpointHandler::m_records.empty()) {
+        BreakpointHandler::m_records.resize(RECORD_CAPACITY);
+    }
+
+    TraceRecord& record = BreakpointHandler::m_records[BreakpointHandler::m_recorded % RECORD_CAPACITY];
+
+    record.id = breakpoint.id;
+    record.address = breakpoint.address;
+    record.count = min(breakpoint.collect_programs.size(), TraceRecord::MAX_VALUES);
+    record.valid = 0;
+
+    for (size_t i = 0; i < record.count; i++) {
+        record.values[i] = 0;
+
+        if (ExpressionHandler::evaluate(breakpoint.collect_programs[i], record.values[i])) {
+            record.valid |= (1 << i);
+        }
+    }
+
+    BreakpointHandler::m_recorded += 1;
+}
+
+// the newest count records, oldest first
+vector<TraceRecord> BreakpointHandler::records(size_t count)
+{
+    vector<TraceRecord> records;
+
+    count = min({ count, (size_t)BreakpointHandler::m_recorded, RECORD_CAPACITY });
+
+    for (unsigned long i = BreakpointHandler::m_recorded - count; i < BreakpointHandler::m_recorded; i++) {
+        records.push_back(BreakpointHandler::m_records[i % RECORD_CAPACITY]);
     }
 
-    return -1;
+    return records;
 }
 
-Breakpoint BreakpointHandler::get(int index)
+unsigned long BreakpointHandler::recorded()
 {
-    return BreakpointHandler::m_breakpoints[index];
+    return BreakpointHandler::m_recorded;
 }
@@ -0,0 +1,150 @@
+#include "CheckpointHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <csignal>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+
+#include "ptools.h"
+#include "BreakpointHandler.h"
+#include "MemoryHandler.h"
+#include "RegisterHandler.h"
+#include "SymbolHandler.h"
+
+using namespace std;
+
+int CheckpointHandler::m_next_id = 1;
+vector<Checkpoint> CheckpointHandler::m_checkpoints;
+
+CheckpointHandler::CheckpointHandler()
+{
+}
+
+CheckpointHandler::~CheckpointHandler()
+{
+    CheckpointHandler::clear();
+}
+
+// inject a fork into thread tid of pid, the memory and register handlers have to follow pid and tid and still do afterwards
+// it is a clone without exit signal, so the parent never gets a SIGCHLD for it and its wait() without __WALL never sees it
+// the copy is traced through PTRACE_O_TRACECLONE and kept at its first stop, with the registers and code tid had before the injection
+pid_t CheckpointHandler::fork(pid_t pid, pid_t tid)
+{
+    struct user_regs_struct saved = RegisterHandler::get();
+    unsigned char code[2];
+
+    if (MemoryHandler::read(saved.rip, code, 2) != 2) return -1;
+
+    long result = inject_syscall(tid, SYS_clone, { 0, 0, 0, 0, 0 });
+
+    RegisterHandler::flush();
+
+    if (result <= 0) return -1;
+
+    pid_t forked = result;
+    int status = 0;
+
+    if (waitpid(forked, &status, __WALL) != forked || !WIFSTOPPED(status)) return -1;
+
+    // the copy returned from the injected syscall, its instruction and registers are put back as well
+    MemoryHandler::attach(forked);
+    MemoryHandler::write(saved.rip, code, 2);
+    MemoryHandler::attach(pid);
+
+    ptrace(PTRACE_SETREGS, forked, 0, &saved);
+
+    return forked;
+}
+
+// only thread tid is in the checkpoint, a fork keeps no other thread of the process
+Checkpoint const* CheckpointHandler::take(pid_t pid, pid_t tid, int status)
+{
+    pid_t forked = CheckpointHandler::fork(pid, tid);
+
+    if (forked < 0) {
+        cerr << "** [checkpoint] error, cannot fork the program" << '\n';
+
+        return NULL;
+    }
+
+    Checkpoint checkpoint = { CheckpointHandler::m_next_id++, forked, status, RegisterHandler::get().rip, {} };
+
+    for (auto breakpoint : BreakpointHandler::list()) {
+        if (breakpoint->enabled) {
+            checkpoint.breakpoints.push_back(make_pair(breakpoint->address, (unsigned char)breakpoint->code));
+        }
+    }
+
+    CheckpointHandler::m_checkpoints.push_back(checkpoint);
+
+    return &CheckpointHandler::m_checkpoints.back();
+}
+
+// -1 is the latest checkpoint
+Checkpoint const* CheckpointHandler::get(int id)
+{
+    if (id == -1 && !CheckpointHandler::m_checkpoints.empty()) {
+        return &CheckpointHandler::m_checkpoints.back();
+    }
+
+    for (auto& checkpoint : CheckpointHandler::m_checkpoints) {
+        if (checkpoint.id == id) return &checkpoint;
+    }
+
+    return NULL;
+}
+
+void CheckpointHandler::list()
+{
+    if (CheckpointHandler::m_checkpoints.empty()) {
+        cout << "no checkpoint" << '\n';
+
+        return;
+    }
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    for (auto& checkpoint : CheckpointHandler::m_checkpoints) {
+        cout << dec << checkpoint.id << ": " << hex << checkpoint.address;
+
+        string symbol = SymbolHandler::symbolize(checkpoint.address);
+        if (!symbol.empty()) {
+            cout << " <" << symbol << ">";
+        }
+
+        cout << " pid " << dec << checkpoint.pid << '\n';
+    }
+
+    cout.copyfmt(state);
+}
+
+// a checkpoint never runs again, it is killed and reaped right away
+bool CheckpointHandler::remove(int id)
+{
+    auto it = find_if(CheckpointHandler::m_checkpoints.begin(), CheckpointHandler::m_checkpoints.end(), [id](Checkpoint const& checkpoint) {
+        return checkpoint.id == id;
+    });
+
+    if (it == CheckpointHandler::m_checkpoints.end()) return false;
+
+    int status = 0;
+
+    kill(it->pid, SIGKILL);
+    while (waitpid(it->pid, &status, __WALL) == it->pid && WIFSTOPPED(status));
+
+    CheckpointHandler::m_checkpoints.erase(it);
+
+    return true;
+}
+
+void CheckpointHandler::clear()
+{
+    while (!CheckpointHandler::m_checkpoints.empty()) {
+        CheckpointHandler::remove(CheckpointHandler::m_checkpoints.back().id);
+    }
+}
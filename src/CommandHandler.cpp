@@ -3,22 +3,57 @@
 using namespace std;
 
 vector<CommandHandler::Command> CommandHandler::m_commands{
+    Command("attach", "", (1 << STATUS::NONE), COMMAND_TYPE::ATTACH),
     Command("break", "b", (1 << STATUS::RUNNING), COMMAND_TYPE::BREAK),
+    Command("break-file", "", (1 << STATUS::RUNNING), COMMAND_TYPE::BREAK_FILE),
+    Command("checkpoint", "", (1 << STATUS::RUNNING), COMMAND_TYPE::CHECKPOINT),
+    Command("condition", "", (1 << STATUS::RUNNING), COMMAND_TYPE::CONDITION),
     Command("cont", "c", (1 << STATUS::RUNNING), COMMAND_TYPE::CONT),
+    Command("counts", "", (1 << STATUS::RUNNING), COMMAND_TYPE::COUNTS),
     Command("delete", "", (1 << STATUS::RUNNING), COMMAND_TYPE::DELETE),
+    Command("detach", "", (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::DETACH),
+    Command("diff", "", (1 << STATUS::RUNNING), COMMAND_TYPE::DIFF),
+    Command("disable", "", (1 << STATUS::RUNNING), COMMAND_TYPE::DISABLE),
     Command("disasm", "d", (1 << STATUS::RUNNING), COMMAND_TYPE::DISASM),
     Command("dump", "x", (1 << STATUS::RUNNING), COMMAND_TYPE::DUMP),
+    Command("enable", "", (1 << STATUS::RUNNING), COMMAND_TYPE::ENABLE),
     Command("exit", "q", (1 << STATUS::NONE) | (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::EXIT),
+    Command("find", "", (1 << STATUS::RUNNING), COMMAND_TYPE::FIND),
+    Command("finish", "", (1 << STATUS::RUNNING), COMMAND_TYPE::FINISH),
+    Command("gcore", "", (1 << STATUS::RUNNING), COMMAND_TYPE::GCORE),
     Command("get", "g", (1 << STATUS::RUNNING), COMMAND_TYPE::GET),
     Command("getregs", "", (1 << STATUS::RUNNING), COMMAND_TYPE::GETREGS),
+    Command("getfpregs", "", (1 << STATUS::RUNNING), COMMAND_TYPE::GETFPREGS),
+    Command("hbreak", "", (1 << STATUS::RUNNING), COMMAND_TYPE::HBREAK),
     Command("help", "h", (1 << STATUS::NONE) | (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::HELP),
+    Command("ignore", "", (1 << STATUS::RUNNING), COMMAND_TYPE::IGNORE),
     Command("list", "l", (1 << STATUS::NONE) | (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::LIST),
     Command("load", "", (1 << STATUS::NONE), COMMAND_TYPE::LOAD),
+    Command("loadmem", "", (1 << STATUS::RUNNING), COMMAND_TYPE::LOADMEM),
+    Command("next", "n", (1 << STATUS::RUNNING), COMMAND_TYPE::NEXT),
+    Command("nonstop", "", (1 << STATUS::NONE) | (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::NONSTOP),
+    Command("patch", "", (1 << STATUS::RUNNING), COMMAND_TYPE::PATCH),
+    Command("profile", "", (1 << STATUS::RUNNING), COMMAND_TYPE::PROFILE),
+    Command("rbreak", "", (1 << STATUS::RUNNING), COMMAND_TYPE::RBREAK),
+    Command("restart", "", (1 << STATUS::RUNNING), COMMAND_TYPE::RESTART),
     Command("run", "r", (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::RUN),
+    Command("savemem", "", (1 << STATUS::RUNNING), COMMAND_TYPE::SAVEMEM),
+    Command("sections", "", (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::SECTIONS),
     Command("vmmap", "m", (1 << STATUS::RUNNING), COMMAND_TYPE::VMMAP),
     Command("set", "s", (1 << STATUS::RUNNING), COMMAND_TYPE::SET),
     Command("si", "", (1 << STATUS::RUNNING), COMMAND_TYPE::SI),
-    Command("start", "", (1 << STATUS::LOADED), COMMAND_TYPE::START)
+    Command("snapshot", "", (1 << STATUS::RUNNING), COMMAND_TYPE::SNAPSHOT),
+    Command("symbols", "", (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::SYMBOLS),
+    Command("syscalls", "", (1 << STATUS::NONE) | (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::SYSCALLS),
+    Command("start", "", (1 << STATUS::LOADED), COMMAND_TYPE::START),
+    Command("tdump", "", (1 << STATUS::NONE) | (1 << STATUS::LOADED) | (1 << STATUS::RUNNING), COMMAND_TYPE::TDUMP),
+    Command("thread", "", (1 << STATUS::RUNNING), COMMAND_TYPE::THREAD),
+    Command("threads", "", (1 << STATUS::RUNNING), COMMAND_TYPE::THREADS),
+    Command("tpoint", "", (1 << STATUS::RUNNING), COMMAND_TYPE::TPOINT),
+    Command("trace", "", (1 << STATUS::RUNNING), COMMAND_TYPE::TRACE),
+    Command("until", "", (1 << STATUS::RUNNING), COMMAND_TYPE::UNTIL),
+    Command("unwatch", "", (1 << STATUS::RUNNING), COMMAND_TYPE::UNWATCH),
+    Command("watch", "w", (1 << STATUS::RUNNING), COMMAND_TYPE::WATCH)
 };
 
 CommandHandler::CommandHandler()
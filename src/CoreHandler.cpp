@@ -0,0 +1,318 @@
+#include "CoreHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/procfs.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/user.h>
+
+#include "ptools.h"
+#include "BreakpointHandler.h"
+
+using namespace std;
+
+// bytes moved with one pread from /proc/<pid>/mem, procfs supports neither copy_file_range nor splice
+static constexpr size_t TRANSFER_SIZE = 1 << 20;
+
+CoreHandler::CoreHandler()
+{
+}
+
+CoreHandler::~CoreHandler()
+{
+}
+
+// name and descriptor are padded to 4 bytes, every note here belongs to "CORE"
+void CoreHandler::note(vector<unsigned char>& notes, unsigned int type, void const* data, size_t size)
+{
+    Elf64_Nhdr header = { 5, (Elf64_Word)size, type };
+    char name[8] = "CORE";
+
+    notes.insert(notes.end(), (unsigned char const*)&header, (unsigned char const*)&header + sizeof(header));
+    notes.insert(notes.end(), name, name + 8);
+    notes.insert(notes.end(), (unsigned char const*)data, (unsigned char const*)data + size);
+    notes.resize((notes.size() + 3) & ~(size_t)3, 0);
+}
+
+// NT_PRPSINFO, then NT_PRSTATUS and NT_FPREGSET of every thread starting with the one that stopped, NT_AUXV and NT_FILE
+vector<unsigned char> CoreHandler::notes(pid_t pid, vector<pid_t> const& threads, int signal, vector<map_entry_t> const& mappings)
+{
+    vector<unsigned char> notes;
+    string proc = "/proc/" + to_string(pid);
+
+    // "pid (comm) state ppid pgrp session ...", comm may contain spaces but not the last ')'
+    string stat;
+    getline(ifstream(proc + "/stat"), stat);
+
+    size_t paren = stat.rfind(')');
+    char state = 't';
+    int ppid = 0, pgrp = 0, session = 0;
+
+    if (paren != string::npos) {
+        istringstream(stat.substr(paren + 2)) >> state >> ppid >> pgrp >> session;
+    }
+
+    struct elf_prpsinfo info;
+    memset(&info, 0, sizeof(info));
+
+    struct stat owner;
+    if (::stat(proc.c_str(), &owner) == 0) {
+        info.pr_uid = owner.st_uid;
+        info.pr_gid = owner.st_gid;
+    }
+
+    info.pr_sname = state;
+    info.pr_pid = pid;
+    info.pr_ppid = ppid;
+    info.pr_pgrp = pgrp;
+    info.pr_sid = session;
+
+    string comm;
+    getline(ifstream(proc + "/comm"), comm);
+    strncpy(info.pr_fname, comm.c_str(), sizeof(info.pr_fname) - 1);
+
+    ifstream cmdline(proc + "/cmdline", ios::binary);
+    string arguments((istreambuf_iterator<char>(cmdline)), istreambuf_iterator<char>());
+    replace(arguments.begin(), arguments.end(), '\0', ' ');
+    strncpy(info.pr_psargs, arguments.c_str(), sizeof(info.pr_psargs) - 1);
+
+    CoreHandler::note(notes, NT_PRPSINFO, &info, sizeof(info));
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        struct elf_prstatus status;
+        struct user_regs_struct regs;
+        struct user_fpregs_struct fpregs;
+
+        memset(&status, 0, sizeof(status));
+        memset(&regs, 0, sizeof(regs));
+        memset(&fpregs, 0, sizeof(fpregs));
+
+        ptrace(PTRACE_GETREGS, threads[i], 0, &regs);
+        bool fpvalid = (ptrace(PTRACE_GETFPREGS, threads[i], 0, &fpregs) == 0);
+
+        status.pr_info.si_signo = (i == 0 ? signal : 0);
+        status.pr_cursig = (i == 0 ? signal : 0);
+        status.pr_pid = threads[i];
+        status.pr_ppid = ppid;
+        status.pr_pgrp = pgrp;
+        status.pr_sid = session;
+        status.pr_fpvalid = fpvalid;
+
+        static_assert(sizeof(status.pr_reg) == sizeof(regs), "elf_gregset_t is laid out as user_regs_struct");
+        memcpy(&status.pr_reg, &regs, sizeof(regs));
+
+        CoreHandler::note(notes, NT_PRSTATUS, &status, sizeof(status));
+
+        if (fpvalid) {
+            CoreHandler::note(notes, NT_FPREGSET, &fpregs, sizeof(fpregs));
+        }
+    }
+
+    ifstream auxv(proc + "/auxv", ios::binary);
+    string vector_data((istreambuf_iterator<char>(auxv)), istreambuf_iterator<char>());
+
+    CoreHandler::note(notes, NT_AUXV, vector_data.data(), vector_data.size());
+
+    // count and page size, a (start, end, page offset) triple per file mapping, then their names
+    unsigned long page_size = sysconf(_SC_PAGESIZE);
+    vector<unsigned long> files = { 0, page_size };
+    string names;
+
+    for (auto& mapping : mappings) {
+        if (mapping.name.empty() || mapping.name[0] != '/') continue;
+
+        files[0] += 1;
+        files.push_back(mapping.range.begin);
+        files.push_back(mapping.range.end);
+        files.push_back(mapping.offset / page_size);
+
+        names += mapping.name;
+        names.push_back('\0');
+    }
+
+    vector<unsigned char> file_note((unsigned char const*)files.data(), (unsigned char const*)(files.data() + files.size()));
+    file_note.insert(file_note.end(), names.begin(), names.end());
+
+    CoreHandler::note(notes, NT_FILE, file_note.data(), file_note.size());
+
+    return notes;
+}
+
+// the first thread is reported as the one that got signal, the process has to be stopped as a whole
+bool CoreHandler::dump(pid_t pid, vector<pid_t> const& threads, int signal, string path)
+{
+    auto begin = chrono::steady_clock::now();
+
+    map<range_t, map_entry_t> maps;
+
+    if (load_maps(pid, maps) < 0) {
+        cerr << "** [gcore] error, cannot read the memory layout" << '\n';
+
+        return false;
+    }
+
+    vector<map_entry_t> mappings;
+
+    for (auto& [range, mapping] : maps) {
+        // the kernel leaves [vsyscall] out of its cores as well, it is the same in every process
+        if (mapping.name == "[vsyscall]") continue;
+
+        mappings.push_back(mapping);
+    }
+
+    int memory = open(("/proc/" + to_string(pid) + "/mem").c_str(), O_RDONLY);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (memory < 0 || fd < 0) {
+        cerr << "** [gcore] error, cannot open " << (memory < 0 ? "the memory of the process" : "'" + path + "'") << '\n';
+
+        if (memory >= 0) close(memory);
+        if (fd >= 0) close(fd);
+
+        return false;
+    }
+
+    vector<unsigned char> notes = CoreHandler::notes(pid, threads, signal, mappings);
+
+    unsigned long page_size = sysconf(_SC_PAGESIZE);
+    size_t count = mappings.size() + 1;
+
+    Elf64_Ehdr e_header;
+    memset(&e_header, 0, sizeof(e_header));
+
+    memcpy(e_header.e_ident, ELFMAG, SELFMAG);
+    e_header.e_ident[EI_CLASS] = ELFCLASS64;
+    e_header.e_ident[EI_DATA] = ELFDATA2LSB;
+    e_header.e_ident[EI_VERSION] = EV_CURRENT;
+    e_header.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    e_header.e_type = ET_CORE;
+    e_header.e_machine = EM_X86_64;
+    e_header.e_version = EV_CURRENT;
+    e_header.e_phoff = sizeof(Elf64_Ehdr);
+    e_header.e_ehsize = sizeof(Elf64_Ehdr);
+    e_header.e_phentsize = sizeof(Elf64_Phdr);
+    e_header.e_phnum = count;
+
+    vector<Elf64_Phdr> p_headers(count);
+    memset(p_headers.data(), 0, count * sizeof(Elf64_Phdr));
+
+    unsigned long offset = sizeof(Elf64_Ehdr) + count * sizeof(Elf64_Phdr);
+
+    p_headers[0].p_type = PT_NOTE;
+    p_headers[0].p_offset = offset;
+    p_headers[0].p_filesz = notes.size();
+    p_headers[0].p_align = 4;
+
+    offset = (offset + notes.size() + page_size - 1) / page_size * page_size;
+
+    for (size_t i = 0; i < mappings.size(); i++) {
+        map_entry_t const& mapping = mappings[i];
+        Elf64_Phdr& p_header = p_headers[i + 1];
+
+        // [vvar] has no pages /proc/<pid>/mem can read, the segment only records where it was
+        bool readable = (mapping.permission & 0x04) != 0 && mapping.name != "[vvar]" && mapping.name != "[vvar_vclock]";
+
+        p_header.p_type = PT_LOAD;
+        p_header.p_flags = ((mapping.permission & 0x04) ? PF_R : 0) | ((mapping.permission & 0x02) ? PF_W : 0) | ((mapping.permission & 0x01) ? PF_X : 0);
+        p_header.p_offset = offset;
+        p_header.p_vaddr = mapping.range.begin;
+        p_header.p_memsz = mapping.range.end - mapping.range.begin;
+        p_header.p_filesz = (readable ? p_header.p_memsz : 0);
+        p_header.p_align = page_size;
+
+        offset += p_header.p_filesz;
+    }
+
+    bool success = (pwrite(fd, &e_header, sizeof(e_header), 0) == sizeof(e_header));
+    success = success && (pwrite(fd, p_headers.data(), count * sizeof(Elf64_Phdr), sizeof(e_header)) == (ssize_t)(count * sizeof(Elf64_Phdr)));
+    success = success && (pwrite(fd, notes.data(), notes.size(), p_headers[0].p_offset) == (ssize_t)notes.size());
+
+    vector<unsigned char> buffer(TRANSFER_SIZE);
+    unsigned long written = 0;
+
+    for (size_t i = 1; i < count && success; i++) {
+        Elf64_Phdr const& p_header = p_headers[i];
+
+        for (unsigned long done = 0; done < p_header.p_filesz && success; done += buffer.size()) {
+            size_t length = min((unsigned long)buffer.size(), p_header.p_filesz - done);
+            ssize_t n = pread(memory, buffer.data(), length, p_header.p_vaddr + done);
+
+            // what cannot be read, such as a file mapping past the end of its file, stays a hole of zeros
+            if (n <= 0) continue;
+
+            BreakpointHandler::restore(p_header.p_vaddr + done, buffer.data(), n);
+
+            // runs of pages that are not all zero go out with one write each
+            for (size_t page = 0; page < (size_t)n;) {
+                auto zero = [&](size_t at) {
+                    unsigned long const* words = (unsigned long const*)(buffer.data() + at);
+                    size_t size = min((size_t)page_size, (size_t)n - at) / sizeof(unsigned long);
+
+                    for (size_t j = 0; j < size; j++) {
+                        if (words[j] != 0) return false;
+                    }
+
+                    return true;
+                };
+
+                if (zero(page)) {
+                    page += page_size;
+
+                    continue;
+                }
+
+                size_t end = page + page_size;
+
+                while (end < (size_t)n && !zero(end)) {
+                    end += page_size;
+                }
+
+                end = min(end, (size_t)n);
+
+                success = (pwrite(fd, buffer.data() + page, end - page, p_header.p_offset + done + page) == (ssize_t)(end - page));
+                written += end - page;
+                page = end;
+
+                if (!success) break;
+            }
+        }
+    }
+
+    // the trailing holes are part of the file as well
+    success = success && (ftruncate(fd, offset) == 0);
+
+    struct stat file;
+    fstat(fd, &file);
+
+    close(memory);
+    close(fd);
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - begin;
+
+    if (!success) {
+        cerr << "** [gcore] error, cannot write '" << path << "'" << '\n';
+
+        return false;
+    }
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << "** core written to '" << path << "': " << threads.size() << (threads.size() == 1 ? " thread, " : " threads, ") << mappings.size() << " mappings, ";
+    cout << fixed << setprecision(1) << offset / 1048576.0 << " MB, " << written / 1048576.0 << " MB written, " << file.st_blocks * 512 / 1048576.0 << " MB on disk, ";
+    cout << setprecision(2) << elapsed.count() << " ms" << '\n';
+
+    cout.copyfmt(state);
+
+    return true;
+}
@@ -0,0 +1,263 @@
+#include "DisassembleHandler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// instructions decoded per block, and the bytes read for them (longest x86 instruction is 15 bytes)
+static const size_t BLOCK_INSTRUCTIONS = 64;
+static const size_t BLOCK_BYTES = BLOCK_INSTRUCTIONS * 16;
+
+csh DisassembleHandler::m_handle = 0;
+cs_insn* DisassembleHandler::m_insn = NULL;
+unsigned char const* DisassembleHandler::m_code = NULL;
+vector<unsigned char> DisassembleHandler::m_patched;
+unsigned long DisassembleHandler::m_begin = 0;
+unsigned long DisassembleHandler::m_end = 0;
+size_t DisassembleHandler::m_budget = 16 << 20;
+size_t DisassembleHandler::m_usage = 0;
+map<unsigned long, DisassembleHandler::Block> DisassembleHandler::m_blocks;
+list<unsigned long> DisassembleHandler::m_lru;
+vector<string> DisassembleHandler::m_strings;
+unordered_map<string, unsigned int> DisassembleHandler::m_string_index;
+size_t DisassembleHandler::m_string_usage = 0;
+
+DisassembleHandler::DisassembleHandler()
+{
+}
+
+DisassembleHandler::~DisassembleHandler()
+{
+    DisassembleHandler::unload();
+}
+
+// code is a view of the bytes mapped at [begin, end), instructions are decoded on demand
+bool DisassembleHandler::load(unsigned char const* code, unsigned long begin, unsigned long end)
+{
+    DisassembleHandler::unload();
+
+    if (cs_open(CS_ARCH_X86, CS_MODE_64, &DisassembleHandler::m_handle) != CS_ERR_OK) {
+        cerr << "** [capstone] error, cs_open fail" << '\n';
+
+        return false;
+    }
+
+    DisassembleHandler::m_insn = cs_malloc(DisassembleHandler::m_handle);
+    DisassembleHandler::m_code = code;
+    DisassembleHandler::m_begin = begin;
+    DisassembleHandler::m_end = end;
+
+    return (code != NULL);
+}
+
+void DisassembleHandler::unload()
+{
+    if (DisassembleHandler::m_insn != NULL) {
+        cs_free(DisassembleHandler::m_insn, 1);
+        cs_close(&DisassembleHandler::m_handle);
+    }
+
+    DisassembleHandler::m_insn = NULL;
+    DisassembleHandler::m_code = NULL;
+    DisassembleHandler::m_patched.clear();
+    DisassembleHandler::m_patched.shrink_to_fit();
+    DisassembleHandler::m_begin = 0;
+    DisassembleHandler::m_end = 0;
+
+    DisassembleHandler::clear();
+}
+
+void DisassembleHandler::clear()
+{
+    DisassembleHandler::m_usage = 0;
+    DisassembleHandler::m_blocks.clear();
+    DisassembleHandler::m_lru.clear();
+    DisassembleHandler::m_strings.clear();
+    DisassembleHandler::m_string_index.clear();
+    DisassembleHandler::m_string_usage = 0;
+}
+
+void DisassembleHandler::set_budget(size_t budget)
+{
+    DisassembleHandler::m_budget = budget;
+
+    DisassembleHandler::evict();
+}
+
+bool DisassembleHandler::contains(unsigned long address)
+{
+    return (address >= DisassembleHandler::m_begin && address < DisassembleHandler::m_end);
+}
+
+// mnemonics repeat constantly and operands often do, so every string is stored once
+unsigned int DisassembleHandler::intern(char const* str)
+{
+    auto it = DisassembleHandler::m_string_index.find(str);
+
+    if (it != DisassembleHandler::m_string_index.end()) return it->second;
+
+    unsigned int index = DisassembleHandler::m_strings.size();
+
+    DisassembleHandler::m_strings.push_back(str);
+    DisassembleHandler::m_string_index.emplace(str, index);
+    DisassembleHandler::m_string_usage += 2 * (sizeof(string) + strlen(str) + 1) + sizeof(unsigned int);
+
+    return index;
+}
+
+size_t DisassembleHandler::footprint(Block const& block)
+{
+    return sizeof(Block) + sizeof(unsigned long) * 2 + block.offsets.size() * (sizeof(unsigned int) * 3 + sizeof(unsigned char));
+}
+
+// block in which address is the start of a decoded instruction, blocks may overlap when decoding started mid-stream
+DisassembleHandler::Block* DisassembleHandler::find(unsigned long address, size_t& index)
+{
+    auto it = DisassembleHandler::m_blocks.upper_bound(address);
+
+    while (it != DisassembleHandler::m_blocks.begin()) {
+        it--;
+
+        Block& block = it->second;
+
+        if (address - it->first >= BLOCK_BYTES) return NULL;
+        if (address >= block.end) continue;
+
+        unsigned int offset = address - DisassembleHandler::m_begin;
+        auto instruction = lower_bound(block.offsets.begin(), block.offsets.end(), offset);
+
+        if (instruction != block.offsets.end() && *instruction == offset) {
+            DisassembleHandler::m_lru.splice(DisassembleHandler::m_lru.begin(), DisassembleHandler::m_lru, block.lru);
+
+            index = instruction - block.offsets.begin();
+
+            return &block;
+        }
+    }
+
+    return NULL;
+}
+
+DisassembleHandler::Block* DisassembleHandler::decode(unsigned long address)
+{
+    if (!DisassembleHandler::contains(address) || DisassembleHandler::m_insn == NULL || DisassembleHandler::m_code == NULL) return NULL;
+
+    // the string pool cannot shrink piecewise, so it is dropped with every block once it takes half the budget
+    if (DisassembleHandler::m_string_usage > DisassembleHandler::m_budget / 2) {
+        DisassembleHandler::clear();
+    }
+
+    Block block;
+
+    unsigned char const* code = DisassembleHandler::m_code + (address - DisassembleHandler::m_begin);
+    size_t size = min(BLOCK_BYTES, DisassembleHandler::m_end - address);
+    uint64_t current = address;
+
+    while (block.offsets.size() < BLOCK_INSTRUCTIONS && cs_disasm_iter(DisassembleHandler::m_handle, &code, &size, &current, DisassembleHandler::m_insn)) {
+        block.offsets.push_back(DisassembleHandler::m_insn->address - DisassembleHandler::m_begin);
+        block.sizes.push_back(DisassembleHandler::m_insn->size);
+        block.mnemonics.push_back(DisassembleHandler::intern(DisassembleHandler::m_insn->mnemonic));
+        block.operands.push_back(DisassembleHandler::intern(DisassembleHandler::m_insn->op_str));
+    }
+
+    if (block.offsets.empty()) return NULL;
+
+    block.offsets.shrink_to_fit();
+    block.sizes.shrink_to_fit();
+    block.mnemonics.shrink_to_fit();
+    block.operands.shrink_to_fit();
+    block.end = current;
+
+    DisassembleHandler::m_lru.push_front(address);
+    block.lru = DisassembleHandler::m_lru.begin();
+
+    auto inserted = DisassembleHandler::m_blocks.insert_or_assign(address, move(block));
+
+    DisassembleHandler::m_usage += DisassembleHandler::footprint(inserted.first->second);
+    DisassembleHandler::evict();
+
+    return &(inserted.first->second);
+}
+
+// drop least recently used blocks until the cache fits the budget, the newest block always stays
+void DisassembleHandler::evict()
+{
+    while (DisassembleHandler::m_usage > DisassembleHandler::m_budget && DisassembleHandler::m_lru.size() > 1) {
+        auto it = DisassembleHandler::m_blocks.find(DisassembleHandler::m_lru.back());
+
+        DisassembleHandler::m_usage -= DisassembleHandler::footprint(it->second);
+        DisassembleHandler::m_blocks.erase(it);
+        DisassembleHandler::m_lru.pop_back();
+    }
+}
+
+// up to count instructions starting exactly at address, fewer if the text ends or cannot be decoded
+vector<Instruction> DisassembleHandler::disassemble(unsigned long address, size_t count)
+{
+    vector<Instruction> instructions;
+
+    while (instructions.size() < count) {
+        size_t index = 0;
+        Block* block = DisassembleHandler::find(address, index);
+
+        if (block == NULL) {
+            block = DisassembleHandler::decode(address);
+
+            if (block == NULL) break;
+        }
+
+        for (; index < block->offsets.size() && instructions.size() < count; index++) {
+            Instruction instruction;
+
+            instruction.address = DisassembleHandler::m_begin + block->offsets[index];
+            instruction.size = block->sizes[index];
+            instruction.mnemonic = DisassembleHandler::m_strings[block->mnemonics[index]];
+            instruction.op_str = DisassembleHandler::m_strings[block->operands[index]];
+
+            instructions.push_back(instruction);
+        }
+
+        address = block->end;
+    }
+
+    // raw bytes are not cached, they are copied from the mapped code for the few instructions returned
+    for (auto& instruction : instructions) {
+        memset(instruction.bytes, 0, sizeof(instruction.bytes));
+        memcpy(instruction.bytes, DisassembleHandler::m_code + (instruction.address - DisassembleHandler::m_begin), min((size_t)instruction.size, sizeof(instruction.bytes)));
+    }
+
+    return instructions;
+}
+
+// bytes written into the program replace the mapped ones, which are copied once on the first write
+// blocks with an instruction reaching into the range are dropped and decoded again from the new bytes
+void DisassembleHandler::patch(unsigned long address, unsigned char const* bytes, size_t length)
+{
+    unsigned long begin = max(address, DisassembleHandler::m_begin);
+    unsigned long end = min(address + length, DisassembleHandler::m_end);
+
+    if (begin >= end || DisassembleHandler::m_code == NULL) return;
+
+    if (DisassembleHandler::m_patched.empty()) {
+        DisassembleHandler::m_patched.assign(DisassembleHandler::m_code, DisassembleHandler::m_code + (DisassembleHandler::m_end - DisassembleHandler::m_begin));
+        DisassembleHandler::m_code = DisassembleHandler::m_patched.data();
+    }
+
+    memcpy(DisassembleHandler::m_patched.data() + (begin - DisassembleHandler::m_begin), bytes + (begin - address), end - begin);
+
+    auto it = DisassembleHandler::m_blocks.lower_bound(begin >= BLOCK_BYTES ? begin - BLOCK_BYTES : 0);
+
+    while (it != DisassembleHandler::m_blocks.end() && it->first < end) {
+        if (it->second.end <= begin) {
+            it++;
+
+            continue;
+        }
+
+        DisassembleHandler::m_usage -= DisassembleHandler::footprint(it->second);
+        DisassembleHandler::m_lru.erase(it->second.lru);
+        it = DisassembleHandler::m_blocks.erase(it);
+    }
+}
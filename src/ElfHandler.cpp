@@ -0,0 +1,250 @@
+#include "ElfHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+int ElfHandler::m_fd = -1;
+unsigned char const* ElfHandler::m_data = NULL;
+size_t ElfHandler::m_size = 0;
+vector<Section> ElfHandler::m_sections;
+vector<Elf64_Phdr const*> ElfHandler::m_segments;
+unsigned long ElfHandler::m_bias = 0;
+
+ElfHandler::ElfHandler()
+{
+}
+
+ElfHandler::~ElfHandler()
+{
+    ElfHandler::unload();
+}
+
+bool ElfHandler::in_bounds(size_t offset, size_t size)
+{
+    return (offset <= ElfHandler::m_size && size <= ElfHandler::m_size - offset);
+}
+
+bool ElfHandler::load(string path)
+{
+    ElfHandler::unload();
+
+    ElfHandler::m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (ElfHandler::m_fd == -1) {
+        cerr << "** [elf] error, program not found" << '\n';
+
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(ElfHandler::m_fd, &st) != 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+        cerr << "** [elf] error, file too small" << '\n';
+        ElfHandler::unload();
+
+        return false;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, ElfHandler::m_fd, 0);
+
+    if (data == MAP_FAILED) {
+        cerr << "** [elf] error, mmap fail" << '\n';
+        ElfHandler::unload();
+
+        return false;
+    }
+
+    ElfHandler::m_data = (unsigned char const*)data;
+    ElfHandler::m_size = st.st_size;
+
+    Elf64_Ehdr const* e_header = ElfHandler::header();
+
+    if (memcmp(e_header->e_ident, ELFMAG, SELFMAG) != 0 || e_header->e_ident[EI_CLASS] != ELFCLASS64) {
+        cerr << "** [elf] error, not a 64-bit elf" << '\n';
+        ElfHandler::unload();
+
+        return false;
+    }
+
+    if (e_header->e_shentsize == sizeof(Elf64_Shdr) && ElfHandler::in_bounds(e_header->e_shoff, (size_t)e_header->e_shnum * sizeof(Elf64_Shdr))) {
+        Elf64_Shdr const* s_headers = (Elf64_Shdr const*)(ElfHandler::m_data + e_header->e_shoff);
+
+        char const* sh_str = NULL;
+        size_t sh_str_size = 0;
+
+        if (e_header->e_shstrndx < e_header->e_shnum && ElfHandler::in_bounds(s_headers[e_header->e_shstrndx].sh_offset, s_headers[e_header->e_shstrndx].sh_size)) {
+            sh_str = (char const*)(ElfHandler::m_data + s_headers[e_header->e_shstrndx].sh_offset);
+            sh_str_size = s_headers[e_header->e_shstrndx].sh_size;
+        }
+
+        for (auto i = 0; i < e_header->e_shnum; i++) {
+            Section section;
+
+            section.header = &s_headers[i];
+            section.name = (sh_str != NULL && s_headers[i].sh_name < sh_str_size ? string_view(sh_str + s_headers[i].sh_name, strnlen(sh_str + s_headers[i].sh_name, sh_str_size - s_headers[i].sh_name)) : string_view());
+            section.data = NULL;
+
+            if (s_headers[i].sh_type != SHT_NOBITS && ElfHandler::in_bounds(s_headers[i].sh_offset, s_headers[i].sh_size)) {
+                section.data = ElfHandler::m_data + s_headers[i].sh_offset;
+            }
+
+            ElfHandler::m_sections.push_back(section);
+        }
+    }
+
+    if (e_header->e_phentsize == sizeof(Elf64_Phdr) && ElfHandler::in_bounds(e_header->e_phoff, (size_t)e_header->e_phnum * sizeof(Elf64_Phdr))) {
+        Elf64_Phdr const* p_headers = (Elf64_Phdr const*)(ElfHandler::m_data + e_header->e_phoff);
+
+        for (auto i = 0; i < e_header->e_phnum; i++) {
+            ElfHandler::m_segments.push_back(&p_headers[i]);
+        }
+    }
+
+    return true;
+}
+
+void ElfHandler::unload()
+{
+    if (ElfHandler::m_data != NULL) {
+        munmap((void*)ElfHandler::m_data, ElfHandler::m_size);
+    }
+
+    if (ElfHandler::m_fd != -1) {
+        close(ElfHandler::m_fd);
+    }
+
+    ElfHandler::m_fd = -1;
+    ElfHandler::m_data = NULL;
+    ElfHandler::m_size = 0;
+    ElfHandler::m_sections.clear();
+    ElfHandler::m_segments.clear();
+    ElfHandler::m_bias = 0;
+}
+
+bool ElfHandler::loaded()
+{
+    return (ElfHandler::m_data != NULL);
+}
+
+// only an ET_DYN executable is moved, set before the symbols are loaded
+void ElfHandler::relocate(unsigned long bias)
+{
+    ElfHandler::m_bias = bias;
+}
+
+unsigned long ElfHandler::bias()
+{
+    return ElfHandler::m_bias;
+}
+
+Elf64_Ehdr const* ElfHandler::header()
+{
+    return (Elf64_Ehdr const*)ElfHandler::m_data;
+}
+
+vector<Section> const& ElfHandler::sections()
+{
+    return ElfHandler::m_sections;
+}
+
+vector<Elf64_Phdr const*> const& ElfHandler::segments()
+{
+    return ElfHandler::m_segments;
+}
+
+Section const* ElfHandler::section(string_view name)
+{
+    for (auto& section : ElfHandler::m_sections) {
+        if (section.name == name) return &section;
+    }
+
+    return NULL;
+}
+
+// .symtab / .dynsym together with the string table named by sh_link
+SymbolTable ElfHandler::symbols(string_view name)
+{
+    SymbolTable table = { NULL, 0, NULL, 0 };
+
+    Section const* symtab = ElfHandler::section(name);
+
+    if (symtab == NULL || symtab->data == NULL || symtab->header->sh_link >= ElfHandler::m_sections.size()) return table;
+
+    Section const& strtab = ElfHandler::m_sections[symtab->header->sh_link];
+
+    if (strtab.data == NULL) return table;
+
+    table.symbols = (Elf64_Sym const*)symtab->data;
+    table.count = symtab->header->sh_size / sizeof(Elf64_Sym);
+    table.strings = (char const*)strtab.data;
+    table.strings_size = strtab.header->sh_size;
+
+    return table;
+}
+
+// loadable segment whose file-backed part contains address
+Elf64_Phdr const* ElfHandler::segment(unsigned long address)
+{
+    for (auto p_header : ElfHandler::m_segments) {
+        if (p_header->p_type != PT_LOAD) continue;
+
+        if (address >= p_header->p_vaddr && address < p_header->p_vaddr + p_header->p_filesz) return p_header;
+    }
+
+    return NULL;
+}
+
+// file bytes backing [address, address + length) in the link-time address space, NULL if not fully backed
+unsigned char const* ElfHandler::data(unsigned long address, size_t length)
+{
+    Elf64_Phdr const* p_header = ElfHandler::segment(address);
+
+    if (p_header == NULL || address + length > p_header->p_vaddr + p_header->p_filesz) return NULL;
+
+    size_t offset = p_header->p_offset + (address - p_header->p_vaddr);
+
+    if (!ElfHandler::in_bounds(offset, length)) return NULL;
+
+    return ElfHandler::m_data + offset;
+}
+
+// hex string of the NT_GNU_BUILD_ID note, empty if there is none
+string ElfHandler::build_id()
+{
+    for (auto& section : ElfHandler::m_sections) {
+        if (section.header->sh_type != SHT_NOTE || section.data == NULL) continue;
+
+        size_t offset = 0;
+
+        while (offset + sizeof(Elf64_Nhdr) <= section.header->sh_size) {
+            Elf64_Nhdr const* note = (Elf64_Nhdr const*)(section.data + offset);
+
+            size_t name_offset = offset + sizeof(Elf64_Nhdr);
+            size_t desc_offset = name_offset + ((note->n_namesz + 3) & ~3UL);
+            size_t next = desc_offset + ((note->n_descsz + 3) & ~3UL);
+
+            if (next > section.header->sh_size) break;
+
+            if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && memcmp(section.data + name_offset, "GNU", 4) == 0) {
+                stringstream ss;
+
+                for (size_t i = 0; i < note->n_descsz; i++) {
+                    ss << hex << setw(2) << setfill('0') << (unsigned int)section.data[desc_offset + i];
+                }
+
+                return ss.str();
+            }
+
+            offset = next;
+        }
+    }
+
+    return "";
+}
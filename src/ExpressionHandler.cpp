@@ -0,0 +1,415 @@
+#include "ExpressionHandler.h"
+
+#include <iostream>
+#include <cctype>
+#include <cstdlib>
+
+#include "RegisterTable.h"
+#include "RegisterHandler.h"
+#include "MemoryHandler.h"
+#include "SymbolHandler.h"
+
+using namespace std;
+
+string ExpressionHandler::m_source;
+size_t ExpressionHandler::m_position = 0;
+size_t ExpressionHandler::m_depth = 0;
+size_t ExpressionHandler::m_max_depth = 0;
+vector<Operation>* ExpressionHandler::m_program = NULL;
+
+// binary operators from the loosest to the tightest binding level
+static vector<vector<pair<string, OPCODE>>> const operators = {
+    { { "||", OPCODE::OP_JNZ } },
+    { { "&&", OPCODE::OP_JZ } },
+    { { "|", OPCODE::OP_OR } },
+    { { "^", OPCODE::OP_XOR } },
+    { { "&", OPCODE::OP_AND } },
+    { { "==", OPCODE::OP_EQ }, { "!=", OPCODE::OP_NE } },
+    { { "<=", OPCODE::OP_LE }, { ">=", OPCODE::OP_GE }, { "<", OPCODE::OP_LT }, { ">", OPCODE::OP_GT } },
+    { { "<<", OPCODE::OP_SHL }, { ">>", OPCODE::OP_SHR } },
+    { { "+", OPCODE::OP_ADD }, { "-", OPCODE::OP_SUB } },
+    { { "*", OPCODE::OP_MUL }, { "/", OPCODE::OP_DIV }, { "%", OPCODE::OP_MOD } }
+};
+
+ExpressionHandler::ExpressionHandler()
+{
+}
+
+ExpressionHandler::~ExpressionHandler()
+{
+}
+
+void ExpressionHandler::skip()
+{
+    while (ExpressionHandler::m_position < ExpressionHandler::m_source.size() && isspace(ExpressionHandler::m_source[ExpressionHandler::m_position])) {
+        ExpressionHandler::m_position += 1;
+    }
+}
+
+// a one character operator is not taken from the front of a two character one, "&" never matches "&&"
+bool ExpressionHandler::accept(string token)
+{
+    ExpressionHandler::skip();
+
+    if (ExpressionHandler::m_source.compare(ExpressionHandler::m_position, token.size(), token) != 0) return false;
+
+    if (token.size() == 1 && ExpressionHandler::m_position + 1 < ExpressionHandler::m_source.size()) {
+        string pair = ExpressionHandler::m_source.substr(ExpressionHandler::m_position, 2);
+
+        if (pair == "&&" || pair == "||" || pair == "<<" || pair == ">>" || pair == "<=" || pair == ">=" || pair == "==" || pair == "!=") return false;
+    }
+
+    ExpressionHandler::m_position += token.size();
+
+    return true;
+}
+
+// keeps track of the stack depth so evaluate() can run on a fixed array
+void ExpressionHandler::emit(Operation operation)
+{
+    switch (operation.opcode) {
+        case OPCODE::OP_PUSH:
+        case OPCODE::OP_REGISTER:
+            ExpressionHandler::m_depth += 1;
+
+            break;
+        case OPCODE::OP_LOAD:
+        case OPCODE::OP_NEG:
+        case OPCODE::OP_NOT:
+        case OPCODE::OP_COMPLEMENT:
+        case OPCODE::OP_BOOL:
+            break;
+        default:
+            ExpressionHandler::m_depth -= 1;
+
+            break;
+    }
+
+    ExpressionHandler::m_max_depth = max(ExpressionHandler::m_max_depth, ExpressionHandler::m_depth);
+    ExpressionHandler::m_program->push_back(operation);
+}
+
+bool ExpressionHandler::binary(int level)
+{
+    if (level == (int)operators.size()) return ExpressionHandler::unary();
+
+    if (!ExpressionHandler::binary(level + 1)) return false;
+
+    while (true) {
+        bool found = false;
+
+        for (auto& [token, opcode] : operators[level]) {
+            if (!ExpressionHandler::accept(token)) continue;
+
+            // && and || short-circuit like C, the right side is jumped over once the left side decides
+            if (opcode == OPCODE::OP_JZ || opcode == OPCODE::OP_JNZ) {
+                size_t jump = ExpressionHandler::m_program->size();
+
+                ExpressionHandler::emit(Operation { opcode, 0, 0, 0, 0 });
+
+                if (!ExpressionHandler::binary(level + 1)) return false;
+
+                ExpressionHandler::emit(Operation { OPCODE::OP_BOOL, 0, 0, 0, 0 });
+                (*ExpressionHandler::m_program)[jump].operand = ExpressionHandler::m_program->size();
+            }
+            else {
+                if (!ExpressionHandler::binary(level + 1)) return false;
+
+                ExpressionHandler::emit(Operation { opcode, 0, 0, 0, 0 });
+            }
+
+            found = true;
+
+            break;
+        }
+
+        if (!found) return true;
+    }
+}
+
+bool ExpressionHandler::unary()
+{
+    if (ExpressionHandler::accept("-")) {
+        if (!ExpressionHandler::unary()) return false;
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_NEG, 0, 0, 0, 0 });
+    }
+    else if (ExpressionHandler::accept("!")) {
+        if (!ExpressionHandler::unary()) return false;
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_NOT, 0, 0, 0, 0 });
+    }
+    else if (ExpressionHandler::accept("~")) {
+        if (!ExpressionHandler::unary()) return false;
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_COMPLEMENT, 0, 0, 0, 0 });
+    }
+    else if (ExpressionHandler::accept("*")) {
+        if (!ExpressionHandler::unary()) return false;
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_LOAD, 8, 0, 0, 0 });
+    }
+    else {
+        return ExpressionHandler::primary();
+    }
+
+    return true;
+}
+
+// number, register, symbol, (expr), [expr] or byte/word/dword/qword [expr]
+bool ExpressionHandler::primary()
+{
+    ExpressionHandler::skip();
+
+    string const& source = ExpressionHandler::m_source;
+    size_t& position = ExpressionHandler::m_position;
+
+    if (position >= source.size()) return false;
+
+    if (ExpressionHandler::accept("(")) {
+        return ExpressionHandler::binary(0) && ExpressionHandler::accept(")");
+    }
+
+    if (ExpressionHandler::accept("[")) {
+        if (!ExpressionHandler::binary(0) || !ExpressionHandler::accept("]")) return false;
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_LOAD, 8, 0, 0, 0 });
+
+        return true;
+    }
+
+    if (isdigit(source[position])) {
+        char* end = NULL;
+        unsigned long value = strtoul(source.c_str() + position, &end, 0);
+
+        position = end - source.c_str();
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_PUSH, 0, 0, 0, value });
+
+        return true;
+    }
+
+    if (!isalpha(source[position]) && source[position] != '_' && source[position] != '.') return false;
+
+    size_t begin = position;
+
+    while (position < source.size() && (isalnum(source[position]) || source[position] == '_' || source[position] == '.' || source[position] == '@')) {
+        position += 1;
+    }
+
+    string name = source.substr(begin, position - begin);
+
+    unsigned char width = (name == "byte" ? 1 : name == "word" ? 2 : name == "dword" ? 4 : name == "qword" ? 8 : 0);
+
+    if (width != 0 && ExpressionHandler::accept("[")) {
+        if (!ExpressionHandler::binary(0) || !ExpressionHandler::accept("]")) return false;
+
+        ExpressionHandler::emit(Operation { OPCODE::OP_LOAD, width, 0, 0, 0 });
+
+        return true;
+    }
+
+    RegisterDescriptor const* reg = find_register(name);
+
+    if (reg != NULL) {
+        ExpressionHandler::emit(Operation { OPCODE::OP_REGISTER, reg->width, reg->shift, reg->mask, reg->offset });
+
+        return true;
+    }
+
+    // symbols are resolved now, the program only keeps their address
+    Symbol const* symbol = SymbolHandler::find(name);
+
+    if (symbol != NULL) {
+        ExpressionHandler::emit(Operation { OPCODE::OP_PUSH, 0, 0, 0, symbol->address });
+
+        return true;
+    }
+
+    position = begin;
+
+    return false;
+}
+
+bool ExpressionHandler::compile(string source, vector<Operation>& program)
+{
+    ExpressionHandler::m_source = source;
+    ExpressionHandler::m_position = 0;
+    ExpressionHandler::m_depth = 0;
+    ExpressionHandler::m_max_depth = 0;
+    ExpressionHandler::m_program = &program;
+
+    program.clear();
+
+    bool success = ExpressionHandler::binary(0);
+
+    ExpressionHandler::skip();
+
+    if (!success || ExpressionHandler::m_position != source.size()) {
+        if (ExpressionHandler::m_position >= source.size()) {
+            cerr << "** [expression] error, unexpected end of expression" << '\n';
+        }
+        else {
+            cerr << "** [expression] error, unexpected '" << source.substr(ExpressionHandler::m_position) << "'" << '\n';
+        }
+
+        program.clear();
+
+        return false;
+    }
+
+    if (ExpressionHandler::m_max_depth > ExpressionHandler::STACK_SIZE) {
+        cerr << "** [expression] error, expression too deep" << '\n';
+
+        program.clear();
+
+        return false;
+    }
+
+    return true;
+}
+
+// comparisons are signed, false if memory cannot be read or a division by zero happens
+bool ExpressionHandler::evaluate(vector<Operation> const& program, unsigned long& result)
+{
+    unsigned long stack[ExpressionHandler::STACK_SIZE];
+    size_t top = 0;
+
+    char const* regs = (char const*)&RegisterHandler::get();
+
+    for (size_t pc = 0; pc < program.size(); pc++) {
+        Operation const& operation = program[pc];
+
+        switch (operation.opcode) {
+            case OPCODE::OP_PUSH:
+                stack[top++] = operation.operand;
+
+                break;
+            case OPCODE::OP_REGISTER:
+                stack[top++] = (*(unsigned long const*)(regs + operation.operand) >> operation.shift) & operation.mask;
+
+                break;
+            case OPCODE::OP_LOAD: {
+                unsigned long value = 0;
+
+                if (MemoryHandler::read(stack[top - 1], &value, operation.width) != operation.width) return false;
+
+                stack[top - 1] = value;
+
+                break;
+            }
+            case OPCODE::OP_NEG:
+                stack[top - 1] = -stack[top - 1];
+
+                break;
+            case OPCODE::OP_NOT:
+                stack[top - 1] = !stack[top - 1];
+
+                break;
+            case OPCODE::OP_COMPLEMENT:
+                stack[top - 1] = ~stack[top - 1];
+
+                break;
+            case OPCODE::OP_BOOL:
+                stack[top - 1] = (stack[top - 1] != 0);
+
+                break;
+            case OPCODE::OP_JZ:
+            case OPCODE::OP_JNZ:
+                if ((stack[top - 1] != 0) == (operation.opcode == OPCODE::OP_JNZ)) {
+                    stack[top - 1] = (stack[top - 1] != 0);
+                    pc = operation.operand - 1;
+                }
+                else {
+                    top -= 1;
+                }
+
+                break;
+            default: {
+                unsigned long rhs = stack[--top];
+                unsigned long& lhs = stack[top - 1];
+
+                switch (operation.opcode) {
+                    case OPCODE::OP_MUL:
+                        lhs = lhs * rhs;
+
+                        break;
+                    case OPCODE::OP_DIV:
+                        if (rhs == 0) return false;
+
+                        lhs = lhs / rhs;
+
+                        break;
+                    case OPCODE::OP_MOD:
+                        if (rhs == 0) return false;
+
+                        lhs = lhs % rhs;
+
+                        break;
+                    case OPCODE::OP_ADD:
+                        lhs = lhs + rhs;
+
+                        break;
+                    case OPCODE::OP_SUB:
+                        lhs = lhs - rhs;
+
+                        break;
+                    case OPCODE::OP_SHL:
+                        lhs = lhs << (rhs & 63);
+
+                        break;
+                    case OPCODE::OP_SHR:
+                        lhs = lhs >> (rhs & 63);
+
+                        break;
+                    case OPCODE::OP_LT:
+                        lhs = ((long)lhs < (long)rhs);
+
+                        break;
+                    case OPCODE::OP_LE:
+                        lhs = ((long)lhs <= (long)rhs);
+
+                        break;
+                    case OPCODE::OP_GT:
+                        lhs = ((long)lhs > (long)rhs);
+
+                        break;
+                    case OPCODE::OP_GE:
+                        lhs = ((long)lhs >= (long)rhs);
+
+                        break;
+                    case OPCODE::OP_EQ:
+                        lhs = (lhs == rhs);
+
+                        break;
+                    case OPCODE::OP_NE:
+                        lhs = (lhs != rhs);
+
+                        break;
+                    case OPCODE::OP_AND:
+                        lhs = lhs & rhs;
+
+                        break;
+                    case OPCODE::OP_XOR:
+                        lhs = lhs ^ rhs;
+
+                        break;
+                    case OPCODE::OP_OR:
+                        lhs = lhs | rhs;
+
+                        break;
+                    default:
+                        break;
+                }
+
+                break;
+            }
+        }
+    }
+
+    if (top != 1) return false;
+
+    result = stack[0];
+
+    return true;
+}
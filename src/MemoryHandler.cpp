@@ -0,0 +1,196 @@
+#include "MemoryHandler.h"
+
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/ptrace.h>
+
+using namespace std;
+
+pid_t MemoryHandler::m_pid = -1;
+int MemoryHandler::m_fd = -1;
+unsigned long MemoryHandler::m_page_size = sysconf(_SC_PAGESIZE);
+size_t MemoryHandler::m_page_limit = 4096;
+unordered_map<unsigned long, vector<unsigned char>> MemoryHandler::m_pages;
+
+MemoryHandler::MemoryHandler()
+{
+}
+
+MemoryHandler::~MemoryHandler()
+{
+    MemoryHandler::detach();
+}
+
+void MemoryHandler::attach(pid_t pid)
+{
+    MemoryHandler::detach();
+
+    MemoryHandler::m_pid = pid;
+
+    string filename = "/proc/" + to_string(pid) + "/mem";
+    MemoryHandler::m_fd = open(filename.c_str(), O_RDWR | O_CLOEXEC);
+}
+
+void MemoryHandler::detach()
+{
+    if (MemoryHandler::m_fd != -1) {
+        close(MemoryHandler::m_fd);
+    }
+
+    MemoryHandler::m_pid = -1;
+    MemoryHandler::m_fd = -1;
+
+    MemoryHandler::invalidate();
+}
+
+// cached pages are only valid while the tracee is stopped, drop them before it runs again
+void MemoryHandler::invalidate()
+{
+    MemoryHandler::m_pages.clear();
+}
+
+// read as much of [address, address + length) as is mapped, returns the number of bytes read
+// process_vm_readv stops at the first unreadable page, the rest is retried through /proc/<pid>/mem
+size_t MemoryHandler::raw_read(unsigned long address, void* buffer, size_t length)
+{
+    if (MemoryHandler::m_pid == -1) return 0;
+
+    size_t total = 0;
+
+    while (total < length) {
+        struct iovec local = { (char*)buffer + total, length - total };
+        struct iovec remote = { (void*)(address + total), length - total };
+
+        ssize_t n = process_vm_readv(MemoryHandler::m_pid, &local, 1, &remote, 1, 0);
+
+        if (n <= 0) {
+            if (MemoryHandler::m_fd == -1) break;
+
+            n = pread(MemoryHandler::m_fd, (char*)buffer + total, length - total, address + total);
+
+            if (n <= 0) break;
+        }
+
+        total += n;
+    }
+
+    return total;
+}
+
+// /proc/<pid>/mem ignores page protection for a tracer, so it also patches read-only text
+// without it every word goes through PTRACE_POKETEXT, merging partial words with their current content
+size_t MemoryHandler::raw_write(unsigned long address, void const* buffer, size_t length)
+{
+    if (MemoryHandler::m_pid == -1) return 0;
+
+    if (MemoryHandler::m_fd != -1) {
+        ssize_t n = pwrite(MemoryHandler::m_fd, buffer, length, address);
+
+        if (n == (ssize_t)length) return length;
+    }
+
+    size_t total = 0;
+
+    while (total < length) {
+        unsigned long target = (address + total) & ~7UL;
+        size_t offset = (address + total) - target;
+        size_t n = min(sizeof(unsigned long) - offset, length - total);
+
+        unsigned long code = 0;
+        if (offset != 0 || n != sizeof(unsigned long)) {
+            errno = 0;
+            code = ptrace(PTRACE_PEEKTEXT, MemoryHandler::m_pid, target, 0);
+
+            if (errno != 0) break;
+        }
+
+        memcpy((char*)&code + offset, (char const*)buffer + total, n);
+
+        if (ptrace(PTRACE_POKETEXT, MemoryHandler::m_pid, target, code) != 0) break;
+
+        total += n;
+    }
+
+    return total;
+}
+
+// fetch up to count consecutive pages in one bulk read, returns the number of pages cached
+size_t MemoryHandler::fill(unsigned long page, size_t count)
+{
+    vector<unsigned char> buffer(count * MemoryHandler::m_page_size);
+    size_t n = MemoryHandler::raw_read(page, buffer.data(), buffer.size()) / MemoryHandler::m_page_size;
+
+    for (size_t i = 0; i < n; i++) {
+        auto begin = buffer.begin() + i * MemoryHandler::m_page_size;
+
+        MemoryHandler::m_pages[page + i * MemoryHandler::m_page_size].assign(begin, begin + MemoryHandler::m_page_size);
+    }
+
+    return n;
+}
+
+size_t MemoryHandler::read(unsigned long address, void* buffer, size_t length)
+{
+    size_t total = 0;
+
+    while (total < length) {
+        unsigned long page = (address + total) & ~(MemoryHandler::m_page_size - 1);
+        size_t offset = (address + total) - page;
+        size_t n = min(MemoryHandler::m_page_size - offset, length - total);
+
+        auto it = MemoryHandler::m_pages.find(page);
+
+        if (it == MemoryHandler::m_pages.end()) {
+            // past the limit large reads bypass the cache instead of growing it without bound
+            if (MemoryHandler::m_pages.size() >= MemoryHandler::m_page_limit) {
+                return total + MemoryHandler::raw_read(address + total, (char*)buffer + total, length - total);
+            }
+
+            size_t count = 1;
+            unsigned long last = (address + length - 1) & ~(MemoryHandler::m_page_size - 1);
+
+            while (page + count * MemoryHandler::m_page_size <= last && count < MemoryHandler::m_page_limit - MemoryHandler::m_pages.size()) {
+                if (MemoryHandler::m_pages.count(page + count * MemoryHandler::m_page_size)) break;
+
+                count += 1;
+            }
+
+            if (MemoryHandler::fill(page, count) == 0) break;
+
+            it = MemoryHandler::m_pages.find(page);
+        }
+
+        memcpy((char*)buffer + total, it->second.data() + offset, n);
+        total += n;
+    }
+
+    return total;
+}
+
+// write through to the tracee and keep any cached copy of the touched pages in sync
+size_t MemoryHandler::write(unsigned long address, void const* buffer, size_t length)
+{
+    size_t n = MemoryHandler::raw_write(address, buffer, length);
+    size_t total = 0;
+
+    while (total < n) {
+        unsigned long page = (address + total) & ~(MemoryHandler::m_page_size - 1);
+        size_t offset = (address + total) - page;
+        size_t count = min(MemoryHandler::m_page_size - offset, n - total);
+
+        auto it = MemoryHandler::m_pages.find(page);
+
+        if (it != MemoryHandler::m_pages.end()) {
+            memcpy(it->second.data() + offset, (char const*)buffer + total, count);
+        }
+
+        total += count;
+    }
+
+    return n;
+}
@@ -0,0 +1,167 @@
+#include "ProfileHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include "ptools.h"
+#include "ElfHandler.h"
+#include "SymbolHandler.h"
+
+using namespace std;
+
+map<range_t, map_entry_t> ProfileHandler::m_maps;
+vector<unsigned long> ProfileHandler::m_frames;
+vector<unsigned int> ProfileHandler::m_depths;
+vector<unsigned long> ProfileHandler::m_stop_times;
+set<pid_t> ProfileHandler::m_threads;
+
+ProfileHandler::ProfileHandler()
+{
+}
+
+ProfileHandler::~ProfileHandler()
+{
+}
+
+// function name inside the loaded program, otherwise the basename of the mapping the address falls in
+string ProfileHandler::label(unsigned long address)
+{
+    if (ElfHandler::segment(address - ElfHandler::bias()) != NULL) {
+        Symbol const* symbol = SymbolHandler::find(address);
+
+        if (symbol != NULL) return string(symbol->name);
+    }
+
+    for (auto& [range, entry] : ProfileHandler::m_maps) {
+        if (address < range.begin || address >= range.end) continue;
+
+        if (entry.name.empty()) break;
+
+        return "[" + entry.name.substr(entry.name.find_last_of('/') + 1) + "]";
+    }
+
+    return "[unknown]";
+}
+
+void ProfileHandler::start(pid_t pid)
+{
+    ProfileHandler::m_maps.clear();
+    ProfileHandler::m_frames.clear();
+    ProfileHandler::m_depths.clear();
+    ProfileHandler::m_stop_times.clear();
+    ProfileHandler::m_threads.clear();
+
+    load_maps(pid, ProfileHandler::m_maps);
+}
+
+// stack[0] is the sampled rip, the rest are return addresses from the innermost frame outwards
+// the stacks of all threads go into one profile, as in a flame graph of the whole process
+void ProfileHandler::sample(pid_t tid, vector<unsigned long> const& stack)
+{
+    ProfileHandler::m_frames.insert(ProfileHandler::m_frames.end(), stack.begin(), stack.end());
+    ProfileHandler::m_depths.push_back(stack.size());
+    ProfileHandler::m_threads.insert(tid);
+}
+
+// one tick, every thread sampled in it was stopped for stop_time
+void ProfileHandler::stopped(unsigned long stop_time)
+{
+    ProfileHandler::m_stop_times.push_back(stop_time);
+}
+
+size_t ProfileHandler::samples()
+{
+    return ProfileHandler::m_depths.size();
+}
+
+void ProfileHandler::report(double elapsed, string path)
+{
+    size_t count = ProfileHandler::m_depths.size();
+
+    if (count == 0) {
+        cout << "** no samples" << '\n';
+
+        return;
+    }
+
+    // labels are cached per address, a hot loop is sampled at the same few addresses over and over
+    unordered_map<unsigned long, string> labels;
+
+    auto lookup = [&labels](unsigned long address) -> string const& {
+        auto it = labels.find(address);
+
+        if (it == labels.end()) it = labels.emplace(address, ProfileHandler::label(address)).first;
+
+        return it->second;
+    };
+
+    unordered_map<string, size_t> flat;
+    map<string, size_t> folded;
+
+    size_t offset = 0;
+
+    for (auto depth : ProfileHandler::m_depths) {
+        flat[lookup(ProfileHandler::m_frames[offset])] += 1;
+
+        string stack;
+
+        for (size_t i = depth; i > 0; i--) {
+            if (!stack.empty()) stack += ';';
+
+            stack += lookup(ProfileHandler::m_frames[offset + i - 1]);
+        }
+
+        folded[stack] += 1;
+        offset += depth;
+    }
+
+    vector<pair<string, size_t>> histogram(flat.begin(), flat.end());
+
+    sort(histogram.begin(), histogram.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first;
+    });
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << setw(8) << "samples" << "  " << setw(7) << "percent" << "  " << "symbol" << '\n';
+
+    for (auto& [name, hits] : histogram) {
+        cout << setw(8) << hits << "  " << setw(6) << fixed << setprecision(2) << (100.0 * hits / count) << "%  " << name << '\n';
+    }
+
+    ofstream file(path, ios::out | ios::trunc);
+
+    if (file.is_open()) {
+        for (auto& [stack, hits] : folded) {
+            file << stack << ' ' << hits << '\n';
+        }
+
+        cout << "** folded stacks written to " << path << '\n';
+    }
+    else {
+        cerr << "** [profile] error, cannot open " << path << '\n';
+    }
+
+    vector<unsigned long> times = ProfileHandler::m_stop_times;
+    size_t ticks = times.size();
+    sort(times.begin(), times.end());
+
+    unsigned long total = 0;
+
+    for (auto time : times) {
+        total += time;
+    }
+
+    cout << "** " << count << " samples of " << ProfileHandler::m_threads.size() << (ProfileHandler::m_threads.size() == 1 ? " thread" : " threads") << " in " << ticks << " ticks, " << setprecision(2) << elapsed << " s" << '\n';
+    cout << "** stop time (us): min " << setprecision(1) << times.front() / 1000.0;
+    cout << ", avg " << (double)total / ticks / 1000.0;
+    cout << ", p99 " << times[min(ticks - 1, ticks * 99 / 100)] / 1000.0;
+    cout << ", max " << times.back() / 1000.0 << '\n';
+    cout << "** overhead: " << setprecision(3) << (elapsed > 0 ? 100.0 * total / (elapsed * 1e9) : 0.0) << "% of wall time stopped" << '\n';
+
+    cout.copyfmt(state);
+}
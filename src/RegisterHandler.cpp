@@ -0,0 +1,140 @@
+#include "RegisterHandler.h"
+
+#include <iostream>
+#include <cstring>
+#include <elf.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+
+using namespace std;
+
+pid_t RegisterHandler::m_pid = -1;
+bool RegisterHandler::m_valid = false;
+bool RegisterHandler::m_dirty = false;
+struct user_regs_struct RegisterHandler::m_regs;
+bool RegisterHandler::m_fpregs_valid = false;
+struct user_fpregs_struct RegisterHandler::m_fpregs;
+bool RegisterHandler::m_xstate_valid = false;
+vector<unsigned char> RegisterHandler::m_xstate;
+
+RegisterHandler::RegisterHandler()
+{
+}
+
+RegisterHandler::~RegisterHandler()
+{
+}
+
+void RegisterHandler::attach(pid_t pid)
+{
+    RegisterHandler::m_pid = pid;
+
+    RegisterHandler::invalidate();
+}
+
+void RegisterHandler::detach()
+{
+    RegisterHandler::m_pid = -1;
+
+    RegisterHandler::invalidate();
+}
+
+// registers are fetched at most once per stop, call this whenever the tracee has run
+void RegisterHandler::invalidate()
+{
+    RegisterHandler::m_valid = false;
+    RegisterHandler::m_dirty = false;
+    RegisterHandler::m_fpregs_valid = false;
+    RegisterHandler::m_xstate_valid = false;
+}
+
+// write modified registers back with a single PTRACE_SETREGS, must run before the tracee is resumed
+bool RegisterHandler::flush()
+{
+    if (!RegisterHandler::m_dirty) return true;
+
+    RegisterHandler::m_dirty = false;
+
+    if (ptrace(PTRACE_SETREGS, RegisterHandler::m_pid, 0, &RegisterHandler::m_regs) != 0) {
+        cerr << "** [ptrace] error, set regs" << '\n';
+
+        return false;
+    }
+
+    return true;
+}
+
+struct user_regs_struct const& RegisterHandler::get()
+{
+    if (!RegisterHandler::m_valid) {
+        if (ptrace(PTRACE_GETREGS, RegisterHandler::m_pid, 0, &RegisterHandler::m_regs) != 0) {
+            memset(&RegisterHandler::m_regs, 0, sizeof(RegisterHandler::m_regs));
+        }
+        else {
+            RegisterHandler::m_valid = true;
+        }
+    }
+
+    return RegisterHandler::m_regs;
+}
+
+struct user_regs_struct& RegisterHandler::modify()
+{
+    RegisterHandler::get();
+
+    RegisterHandler::m_dirty = RegisterHandler::m_valid;
+
+    return RegisterHandler::m_regs;
+}
+
+unsigned long RegisterHandler::read(RegisterDescriptor const& reg)
+{
+    unsigned long field = *(unsigned long const*)((char const*)&RegisterHandler::get() + reg.offset);
+
+    return (field >> reg.shift) & reg.mask;
+}
+
+// sub-registers only replace their own bits, the rest of the 64-bit field is kept
+void RegisterHandler::write(RegisterDescriptor const& reg, unsigned long value)
+{
+    unsigned long& field = *(unsigned long*)((char*)&RegisterHandler::modify() + reg.offset);
+
+    field = (field & ~(reg.mask << reg.shift)) | ((value & reg.mask) << reg.shift);
+}
+
+// x87 / SSE state, only fetched when asked for
+struct user_fpregs_struct const& RegisterHandler::fpregs()
+{
+    if (!RegisterHandler::m_fpregs_valid) {
+        struct iovec iov = { &RegisterHandler::m_fpregs, sizeof(RegisterHandler::m_fpregs) };
+
+        if (ptrace(PTRACE_GETREGSET, RegisterHandler::m_pid, NT_PRFPREG, &iov) != 0) {
+            memset(&RegisterHandler::m_fpregs, 0, sizeof(RegisterHandler::m_fpregs));
+        }
+        else {
+            RegisterHandler::m_fpregs_valid = true;
+        }
+    }
+
+    return RegisterHandler::m_fpregs;
+}
+
+// raw XSAVE area (AVX upper halves live at offset 576), empty if the kernel does not expose it
+vector<unsigned char> const& RegisterHandler::xstate()
+{
+    if (!RegisterHandler::m_xstate_valid) {
+        RegisterHandler::m_xstate.resize(4096);
+
+        struct iovec iov = { RegisterHandler::m_xstate.data(), RegisterHandler::m_xstate.size() };
+
+        if (ptrace(PTRACE_GETREGSET, RegisterHandler::m_pid, NT_X86_XSTATE, &iov) != 0) {
+            RegisterHandler::m_xstate.clear();
+        }
+        else {
+            RegisterHandler::m_xstate.resize(iov.iov_len);
+            RegisterHandler::m_xstate_valid = true;
+        }
+    }
+
+    return RegisterHandler::m_xstate;
+}
@@ -0,0 +1,445 @@
+#include "SearchHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <immintrin.h>
+#include <sys/uio.h>
+
+#include "ptools.h"
+#include "BreakpointHandler.h"
+
+using namespace std;
+
+// large enough that one process_vm_readv call dominates its syscall cost, small enough to keep every worker in cache
+static constexpr unsigned long CHUNK_SIZE = 1 << 22;
+
+vector<unsigned char> SearchHandler::m_pattern;
+vector<unsigned char> SearchHandler::m_mask;
+size_t SearchHandler::m_first = 0;
+size_t SearchHandler::m_last = 0;
+bool SearchHandler::m_anchored = false;
+bool SearchHandler::m_exact = false;
+
+SearchHandler::SearchHandler()
+{
+}
+
+SearchHandler::~SearchHandler()
+{
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+    return -1;
+}
+
+// str:text with C escapes, hex:de?d??ef with ? for an unknown nibble, {u,i}{8,16,32,64}:value[/mask] little endian
+bool SearchHandler::compile(string source)
+{
+    vector<unsigned char> pattern, mask;
+
+    size_t colon = source.find(':');
+    string type = (colon == string::npos ? "str" : source.substr(0, colon));
+    string value = (colon == string::npos ? source : source.substr(colon + 1));
+
+    if (type == "str") {
+        for (size_t i = 0; i < value.size(); i++) {
+            unsigned char c = value[i];
+
+            if (c == '\\' && i + 1 < value.size()) {
+                i += 1;
+
+                switch (value[i]) {
+                    case 'n':
+                        c = '\n';
+
+                        break;
+                    case 't':
+                        c = '\t';
+
+                        break;
+                    case 's':
+                        c = ' ';
+
+                        break;
+                    case '0':
+                        c = '\0';
+
+                        break;
+                    case 'x':
+                        if (i + 2 >= value.size() || hex_digit(value[i + 1]) < 0 || hex_digit(value[i + 2]) < 0) {
+                            cerr << "** [find] error, bad escape in '" << value << "'" << '\n';
+
+                            return false;
+                        }
+
+                        c = hex_digit(value[i + 1]) * 16 + hex_digit(value[i + 2]);
+                        i += 2;
+
+                        break;
+                    default:
+                        c = value[i];
+
+                        break;
+                }
+            }
+
+            pattern.push_back(c);
+            mask.push_back(0xff);
+        }
+    }
+    else if (type == "hex") {
+        if (value.size() % 2 != 0) {
+            cerr << "** [find] error, odd number of hex digits in '" << value << "'" << '\n';
+
+            return false;
+        }
+
+        for (size_t i = 0; i < value.size(); i += 2) {
+            unsigned char byte = 0, bits = 0;
+
+            for (size_t j = 0; j < 2; j++) {
+                int digit = hex_digit(value[i + j]);
+
+                byte <<= 4;
+                bits <<= 4;
+
+                if (digit >= 0) {
+                    byte |= digit;
+                    bits |= 0x0f;
+                }
+                else if (value[i + j] != '?') {
+                    cerr << "** [find] error, bad hex digit in '" << value << "'" << '\n';
+
+                    return false;
+                }
+            }
+
+            pattern.push_back(byte);
+            mask.push_back(bits);
+        }
+    }
+    else if (type.size() >= 2 && (type[0] == 'u' || type[0] == 'i')) {
+        int bits = atoi(type.c_str() + 1);
+
+        if (bits != 8 && bits != 16 && bits != 32 && bits != 64) {
+            cerr << "** [find] error, unknown pattern type '" << type << "'" << '\n';
+
+            return false;
+        }
+
+        size_t slash = value.find('/');
+        string number = value.substr(0, slash);
+        char* end = NULL;
+
+        unsigned long integer = (number[0] == '-' ? strtol(number.c_str(), &end, 0) : strtoul(number.c_str(), &end, 0));
+        unsigned long bitmask = ~0UL;
+
+        if (number.empty() || *end != '\0') {
+            cerr << "** [find] error, bad number '" << number << "'" << '\n';
+
+            return false;
+        }
+
+        if (slash != string::npos) {
+            bitmask = strtoul(value.c_str() + slash + 1, &end, 0);
+
+            if (*end != '\0') {
+                cerr << "** [find] error, bad mask '" << value.substr(slash + 1) << "'" << '\n';
+
+                return false;
+            }
+        }
+
+        for (int i = 0; i < bits / 8; i++) {
+            pattern.push_back(integer >> (i * 8));
+            mask.push_back(bitmask >> (i * 8));
+        }
+    }
+    else {
+        cerr << "** [find] error, unknown pattern type '" << type << "'" << '\n';
+
+        return false;
+    }
+
+    if (pattern.empty() || all_of(mask.begin(), mask.end(), [](unsigned char bits) { return bits == 0; })) {
+        cerr << "** [find] error, empty pattern" << '\n';
+
+        return false;
+    }
+
+    for (size_t i = 0; i < pattern.size(); i++) {
+        pattern[i] &= mask[i];
+    }
+
+    SearchHandler::m_pattern = pattern;
+    SearchHandler::m_mask = mask;
+
+    // the outermost fully known bytes filter best, "ab......ab" rarely matches at both ends by chance
+    auto first = std::find(mask.begin(), mask.end(), 0xff);
+    auto last = std::find(mask.rbegin(), mask.rend(), 0xff);
+
+    SearchHandler::m_anchored = (first != mask.end());
+    SearchHandler::m_first = first - mask.begin();
+    SearchHandler::m_last = mask.rend() - last - 1;
+    SearchHandler::m_exact = all_of(mask.begin(), mask.end(), [](unsigned char bits) { return bits == 0xff; });
+
+    return true;
+}
+
+bool SearchHandler::verify(unsigned char const* data)
+{
+    if (SearchHandler::m_exact) return memcmp(data, SearchHandler::m_pattern.data(), SearchHandler::m_pattern.size()) == 0;
+
+    for (size_t i = 0; i < SearchHandler::m_pattern.size(); i++) {
+        if ((data[i] & SearchHandler::m_mask[i]) != SearchHandler::m_pattern[i]) return false;
+    }
+
+    return true;
+}
+
+// every start offset from begin up to limit, the pattern has to fit into length
+void SearchHandler::scan_scalar(unsigned char const* data, size_t length, size_t begin, size_t limit, vector<unsigned long>& offsets)
+{
+    size_t size = SearchHandler::m_pattern.size();
+
+    for (size_t i = begin; i < limit && i + size <= length; i++) {
+        if (SearchHandler::verify(data + i)) {
+            offsets.push_back(i);
+        }
+    }
+}
+
+void SearchHandler::scan_sse2(unsigned char const* data, size_t length, size_t limit, vector<unsigned long>& offsets)
+{
+    size_t size = SearchHandler::m_pattern.size();
+    size_t first = SearchHandler::m_first, last = SearchHandler::m_last;
+
+    if (length < size) return;
+
+    size_t end = min(limit, length - size + 1);
+
+    __m128i const lhs = _mm_set1_epi8(SearchHandler::m_pattern[first]);
+    __m128i const rhs = _mm_set1_epi8(SearchHandler::m_pattern[last]);
+
+    size_t i = 0;
+
+    for (; i + 16 <= end; i += 16) {
+        __m128i a = _mm_loadu_si128((__m128i const*)(data + i + first));
+        __m128i b = _mm_loadu_si128((__m128i const*)(data + i + last));
+
+        unsigned int bits = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, lhs), _mm_cmpeq_epi8(b, rhs)));
+
+        while (bits != 0) {
+            size_t offset = i + __builtin_ctz(bits);
+
+            if (SearchHandler::verify(data + offset)) {
+                offsets.push_back(offset);
+            }
+
+            bits &= bits - 1;
+        }
+    }
+
+    SearchHandler::scan_scalar(data, length, i, end, offsets);
+}
+
+__attribute__((target("avx2"))) void SearchHandler::scan_avx2(unsigned char const* data, size_t length, size_t limit, vector<unsigned long>& offsets)
+{
+    size_t size = SearchHandler::m_pattern.size();
+    size_t first = SearchHandler::m_first, last = SearchHandler::m_last;
+
+    if (length < size) return;
+
+    size_t end = min(limit, length - size + 1);
+
+    __m256i const lhs = _mm256_set1_epi8(SearchHandler::m_pattern[first]);
+    __m256i const rhs = _mm256_set1_epi8(SearchHandler::m_pattern[last]);
+
+    size_t i = 0;
+
+    for (; i + 32 <= end; i += 32) {
+        __m256i a = _mm256_loadu_si256((__m256i const*)(data + i + first));
+        __m256i b = _mm256_loadu_si256((__m256i const*)(data + i + last));
+
+        unsigned int bits = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, lhs), _mm256_cmpeq_epi8(b, rhs)));
+
+        while (bits != 0) {
+            size_t offset = i + __builtin_ctz(bits);
+
+            if (SearchHandler::verify(data + offset)) {
+                offsets.push_back(offset);
+            }
+
+            bits &= bits - 1;
+        }
+    }
+
+    SearchHandler::scan_scalar(data, length, i, end, offsets);
+}
+
+// matches are printed in address order while the workers are still scanning the chunks after them
+void SearchHandler::find(pid_t pid, string region, size_t limit)
+{
+    map<range_t, map_entry_t> maps;
+
+    if (load_maps(pid, maps) < 0) {
+        cerr << "** [find] error, cannot read the memory layout" << '\n';
+
+        return;
+    }
+
+    // a region is an address range begin-end or part of a mapping name such as [heap] or libc
+    unsigned long low = 0, high = ~0UL;
+    size_t dash = region.find('-');
+
+    if (!region.empty() && dash != string::npos && region.find_first_not_of("0123456789abcdefABCDEFx-") == string::npos) {
+        low = strtoul(region.substr(0, dash).c_str(), NULL, 16);
+        high = strtoul(region.substr(dash + 1).c_str(), NULL, 16);
+        region.clear();
+    }
+
+    vector<SearchChunk> chunks;
+    vector<range_t> bounds;
+    size_t mappings = 0;
+    unsigned long total = 0;
+
+    for (auto& [range, mapping] : maps) {
+        // [vvar] cannot be read and [vsyscall] is the same in every process
+        if ((mapping.permission & 0x04) == 0 || mapping.name == "[vvar]" || mapping.name == "[vvar_vclock]" || mapping.name == "[vsyscall]") continue;
+
+        if (!region.empty() && mapping.name.find(region) == string::npos) continue;
+
+        unsigned long begin = max(range.begin, low), end = min(range.end, high);
+
+        if (begin >= end) continue;
+
+        mappings += 1;
+        total += end - begin;
+
+        for (unsigned long address = begin; address < end; address += CHUNK_SIZE) {
+            chunks.push_back(SearchChunk { &mapping, address, min(address + CHUNK_SIZE, end), false, {} });
+            bounds.push_back(range_t { begin, end });
+        }
+    }
+
+    if (chunks.empty()) {
+        cerr << "** [find] error, no readable memory in '" << region << "'" << '\n';
+
+        return;
+    }
+
+    bool avx2 = __builtin_cpu_supports("avx2");
+    size_t size = SearchHandler::m_pattern.size();
+    size_t workers = min((size_t)max(thread::hardware_concurrency(), 1u), chunks.size());
+
+    atomic<size_t> next(0);
+    mutex lock;
+    condition_variable finished;
+
+    auto begin = chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        vector<unsigned char> buffer(CHUNK_SIZE + size - 1);
+        vector<unsigned long> offsets;
+
+        for (size_t index = next++; index < chunks.size(); index = next++) {
+            SearchChunk& chunk = chunks[index];
+
+            // the chunk reads on by size - 1 bytes so a match across its end is still found once
+            size_t length = min(chunk.end + size - 1, bounds[index].end) - chunk.begin;
+
+            struct iovec local = { buffer.data(), length };
+            struct iovec remote = { (void*)chunk.begin, length };
+
+            ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+
+            length = (n < 0 ? 0 : n);
+
+            // memory shows the int3s of our break points, the scan sees the original bytes instead
+            BreakpointHandler::restore(chunk.begin, buffer.data(), length);
+
+            offsets.clear();
+
+            if (!SearchHandler::m_anchored) {
+                SearchHandler::scan_scalar(buffer.data(), length, 0, chunk.end - chunk.begin, offsets);
+            }
+            else if (avx2) {
+                SearchHandler::scan_avx2(buffer.data(), length, chunk.end - chunk.begin, offsets);
+            }
+            else {
+                SearchHandler::scan_sse2(buffer.data(), length, chunk.end - chunk.begin, offsets);
+            }
+
+            unique_lock<mutex> guard(lock);
+
+            for (auto offset : offsets) {
+                chunk.matches.push_back(chunk.begin + offset);
+            }
+
+            chunk.done = true;
+            finished.notify_all();
+        }
+    };
+
+    vector<thread> threads;
+
+    for (size_t i = 0; i < workers; i++) {
+        threads.emplace_back(worker);
+    }
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    size_t matches = 0;
+
+    for (auto& chunk : chunks) {
+        vector<unsigned long> addresses;
+
+        {
+            unique_lock<mutex> guard(lock);
+
+            finished.wait(guard, [&chunk]() { return chunk.done; });
+
+            addresses.swap(chunk.matches);
+        }
+
+        for (auto address : addresses) {
+            if (matches < limit) {
+                string name = (chunk.mapping->name.empty() ? "[anonymous]" : chunk.mapping->name);
+
+                cout << hex << setw(12) << setfill(' ') << right << address << "  " << name << "+0x" << address - chunk.mapping->range.begin << '\n';
+            }
+
+            matches += 1;
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+    if (matches > limit) {
+        cout << "** " << dec << matches - limit << " more matches not shown" << '\n';
+    }
+
+    cout << "** " << dec << matches << " matches in " << fixed << setprecision(1) << total / 1048576.0 << " MB of " << mappings << " mappings, ";
+    cout << workers << (workers == 1 ? " thread" : " threads") << ", " << (!SearchHandler::m_anchored ? "scalar" : avx2 ? "avx2" : "sse2") << ", ";
+    cout << setprecision(2) << elapsed.count() * 1000 << " ms, " << total / elapsed.count() / 1e9 << " GB/s" << '\n';
+
+    cout.copyfmt(state);
+}
@@ -0,0 +1,564 @@
+#include "SnapshotHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <emmintrin.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "ptools.h"
+#include "BreakpointHandler.h"
+
+using namespace std;
+
+// bits of a /proc/<pid>/pagemap entry
+static constexpr unsigned long PAGEMAP_SOFT_DIRTY = 1UL << 55;
+
+// bytes shown of every changed range
+static constexpr size_t PREVIEW = 16;
+
+// pages read with one process_vm_readv call
+static constexpr size_t RUN_PAGES = 256;
+
+pid_t SnapshotHandler::m_pid = -1;
+int SnapshotHandler::m_next_id = 1;
+unsigned long SnapshotHandler::m_page_size = 0;
+bool SnapshotHandler::m_soft_dirty = true;
+int SnapshotHandler::m_baseline = 0;
+vector<Snapshot> SnapshotHandler::m_snapshots;
+
+SnapshotHandler::SnapshotHandler()
+{
+}
+
+SnapshotHandler::~SnapshotHandler()
+{
+}
+
+void SnapshotHandler::attach(pid_t pid)
+{
+    SnapshotHandler::m_pid = pid;
+    SnapshotHandler::m_next_id = 1;
+    SnapshotHandler::m_page_size = sysconf(_SC_PAGESIZE);
+    SnapshotHandler::m_soft_dirty = SnapshotHandler::probe();
+    SnapshotHandler::m_baseline = 0;
+    SnapshotHandler::m_snapshots.clear();
+}
+
+void SnapshotHandler::detach()
+{
+    SnapshotHandler::m_pid = -1;
+    SnapshotHandler::m_snapshots.clear();
+}
+
+// only writable memory changes without us, [vvar] and [vsyscall] are never written by the program
+vector<map_entry_t> SnapshotHandler::mappings()
+{
+    map<range_t, map_entry_t> maps;
+    vector<map_entry_t> mappings;
+
+    load_maps(SnapshotHandler::m_pid, maps);
+
+    for (auto& [range, mapping] : maps) {
+        if ((mapping.permission & 0x06) != 0x06 || mapping.name == "[vvar]" || mapping.name == "[vsyscall]") continue;
+
+        mappings.push_back(mapping);
+    }
+
+    return mappings;
+}
+
+// one entry per page of the mapping, every page counts as soft-dirty if pagemap cannot be read
+vector<unsigned long> SnapshotHandler::pagemap(map_entry_t const& mapping)
+{
+    size_t count = (mapping.range.end - mapping.range.begin) / SnapshotHandler::m_page_size;
+    vector<unsigned long> entries(count, PAGEMAP_SOFT_DIRTY);
+
+    string path = "/proc/" + to_string(SnapshotHandler::m_pid) + "/pagemap";
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) return entries;
+
+    off_t offset = mapping.range.begin / SnapshotHandler::m_page_size * sizeof(unsigned long);
+
+    if (pread(fd, entries.data(), count * sizeof(unsigned long), offset) != (ssize_t)(count * sizeof(unsigned long))) {
+        fill(entries.begin(), entries.end(), PAGEMAP_SOFT_DIRTY);
+    }
+
+    close(fd);
+
+    return entries;
+}
+
+// the kernel accepts clear_refs without CONFIG_MEM_SOFT_DIRTY but never sets the bit, so it is tried on a page of our own
+bool SnapshotHandler::probe()
+{
+    unsigned long page_size = sysconf(_SC_PAGESIZE);
+    unsigned long entry = 0;
+
+    volatile unsigned char* page = (volatile unsigned char*)mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (page == MAP_FAILED) return false;
+
+    page[0] = 1;
+
+    int clear = open("/proc/self/clear_refs", O_WRONLY);
+    int pagemap = open("/proc/self/pagemap", O_RDONLY);
+
+    if (clear >= 0 && pagemap >= 0 && write(clear, "4", 1) == 1) {
+        page[0] = 2;
+
+        if (pread(pagemap, &entry, sizeof(entry), (unsigned long)page / page_size * sizeof(entry)) != sizeof(entry)) {
+            entry = 0;
+        }
+    }
+
+    if (clear >= 0) close(clear);
+    if (pagemap >= 0) close(pagemap);
+
+    munmap((void*)page, page_size);
+
+    return (entry & PAGEMAP_SOFT_DIRTY) != 0;
+}
+
+// soft-dirty bits tell what changed since the latest snapshot only while it is the one they were cleared for
+bool SnapshotHandler::tracked()
+{
+    return SnapshotHandler::m_soft_dirty && !SnapshotHandler::m_snapshots.empty() && SnapshotHandler::m_snapshots.back().id == SnapshotHandler::m_baseline;
+}
+
+// "4" clears the soft-dirty bit of every page, the kernel sets it again on the next write
+bool SnapshotHandler::clear_refs()
+{
+    string path = "/proc/" + to_string(SnapshotHandler::m_pid) + "/clear_refs";
+    int fd = open(path.c_str(), O_WRONLY);
+
+    if (fd < 0) return false;
+
+    bool success = (write(fd, "4", 1) == 1);
+
+    close(fd);
+
+    return success;
+}
+
+// memory that cannot be read is taken as zero, break points show their original code
+size_t SnapshotHandler::read(unsigned long address, unsigned char* buffer, size_t length)
+{
+    size_t total = 0;
+
+    while (total < length) {
+        struct iovec local = { buffer + total, length - total };
+        struct iovec remote = { (void*)(address + total), length - total };
+
+        ssize_t n = process_vm_readv(SnapshotHandler::m_pid, &local, 1, &remote, 1, 0);
+
+        if (n <= 0) break;
+
+        total += n;
+    }
+
+    memset(buffer + total, 0, length - total);
+
+    BreakpointHandler::restore(address, buffer, length);
+
+    return total;
+}
+
+PageCopy SnapshotHandler::compress(unsigned char const* page)
+{
+    unsigned long const* words = (unsigned long const*)page;
+    size_t count = SnapshotHandler::m_page_size / sizeof(unsigned long);
+    size_t bitmap = count / 64;
+
+    vector<unsigned long> copy(bitmap, 0);
+
+    for (size_t i = 0; i < count; i++) {
+        if (words[i] == 0) continue;
+
+        copy[i / 64] |= 1UL << (i % 64);
+        copy.push_back(words[i]);
+    }
+
+    if (copy.size() == bitmap) return NULL;
+
+    copy.shrink_to_fit();
+
+    return make_shared<vector<unsigned long> const>(move(copy));
+}
+
+void SnapshotHandler::decompress(PageCopy const& copy, unsigned char* page)
+{
+    memset(page, 0, SnapshotHandler::m_page_size);
+
+    if (copy == NULL) return;
+
+    unsigned long* words = (unsigned long*)page;
+    size_t bitmap = SnapshotHandler::m_page_size / sizeof(unsigned long) / 64;
+    size_t next = bitmap;
+
+    for (size_t i = 0; i < bitmap; i++) {
+        for (unsigned long bits = (*copy)[i]; bits != 0; bits &= bits - 1) {
+            words[i * 64 + __builtin_ctzl(bits)] = (*copy)[next++];
+        }
+    }
+}
+
+// the first byte from offset on where the pages differ, the page size if there is none
+// 64 bytes are compared at a time, the first differing block is then searched byte by byte
+size_t SnapshotHandler::compare(unsigned char const* lhs, unsigned char const* rhs, size_t offset)
+{
+    size_t size = SnapshotHandler::m_page_size;
+    size_t i = offset & ~(size_t)63;
+
+    for (; i < size; i += 64) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(lhs + i)), _mm_loadu_si128((__m128i const*)(rhs + i)));
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(lhs + i + 16)), _mm_loadu_si128((__m128i const*)(rhs + i + 16)));
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(lhs + i + 32)), _mm_loadu_si128((__m128i const*)(rhs + i + 32)));
+        __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(lhs + i + 48)), _mm_loadu_si128((__m128i const*)(rhs + i + 48)));
+
+        if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d))) == 0xffff) continue;
+
+        for (size_t j = max(i, offset); j < i + 64; j++) {
+            if (lhs[j] != rhs[j]) return j;
+        }
+    }
+
+    return size;
+}
+
+// every page is read for the first snapshot, later ones only read the pages written since the one before
+void SnapshotHandler::take()
+{
+    auto begin = chrono::steady_clock::now();
+
+    Snapshot* previous = (SnapshotHandler::m_snapshots.empty() ? NULL : &SnapshotHandler::m_snapshots.back());
+    Snapshot snapshot { SnapshotHandler::m_next_id, SnapshotHandler::mappings(), {}, 0, 0 };
+
+    size_t page_size = SnapshotHandler::m_page_size;
+    size_t pages_read = 0;
+    vector<unsigned char> buffer;
+
+    for (auto& mapping : snapshot.mappings) {
+        vector<unsigned long> entries;
+
+        if (previous != NULL && SnapshotHandler::tracked()) {
+            entries = SnapshotHandler::pagemap(mapping);
+        }
+
+        // runs of pages to read are collected so one process_vm_readv covers each of them
+        unsigned long run = 0;
+        size_t count = 0;
+
+        auto flush = [&]() {
+            if (count == 0) return;
+
+            buffer.resize(count * page_size);
+            SnapshotHandler::read(run, buffer.data(), buffer.size());
+
+            for (size_t i = 0; i < count; i++) {
+                unsigned long address = run + i * page_size;
+                PageCopy copy = SnapshotHandler::compress(buffer.data() + i * page_size);
+
+                // a page written back with the same content is still shared
+                PageCopy const* shared = NULL;
+
+                if (previous != NULL) {
+                    auto it = previous->pages.find(address);
+
+                    if (it != previous->pages.end()) {
+                        shared = &it->second;
+                    }
+                }
+
+                if (shared != NULL && (copy == *shared || (copy != NULL && *shared != NULL && *copy == **shared))) {
+                    copy = *shared;
+                }
+                else {
+                    snapshot.copied += 1;
+                    snapshot.stored += (copy == NULL ? 0 : copy->size() * sizeof(unsigned long));
+                }
+
+                snapshot.pages[address] = copy;
+            }
+
+            pages_read += count;
+            count = 0;
+        };
+
+        for (unsigned long address = mapping.range.begin; address < mapping.range.end; address += page_size) {
+            size_t index = (address - mapping.range.begin) / page_size;
+
+            if (!entries.empty() && (entries[index] & PAGEMAP_SOFT_DIRTY) == 0) {
+                auto it = previous->pages.find(address);
+
+                if (it != previous->pages.end()) {
+                    flush();
+
+                    snapshot.pages.insert(*it);
+
+                    continue;
+                }
+            }
+
+            if (count == RUN_PAGES) {
+                flush();
+            }
+
+            if (count == 0) {
+                run = address;
+            }
+
+            count += 1;
+        }
+
+        flush();
+    }
+
+    if (SnapshotHandler::m_soft_dirty && !SnapshotHandler::clear_refs()) {
+        SnapshotHandler::m_soft_dirty = false;
+    }
+
+    SnapshotHandler::m_baseline = snapshot.id;
+
+    if (!SnapshotHandler::m_soft_dirty && previous == NULL) {
+        cout << "** soft-dirty bits are not available, every snapshot and diff reads all pages" << '\n';
+    }
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - begin;
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << "** snapshot " << dec << snapshot.id << ": " << snapshot.pages.size() << " pages in " << snapshot.mappings.size() << " mappings, ";
+    cout << pages_read << " read, " << snapshot.copied << " copied, " << fixed << setprecision(2) << snapshot.stored / 1048576.0 << " MB stored for ";
+    cout << snapshot.copied * page_size / 1048576.0 << " MB, " << elapsed.count() << " ms" << '\n';
+
+    cout.copyfmt(state);
+
+    SnapshotHandler::m_next_id += 1;
+    SnapshotHandler::m_snapshots.push_back(move(snapshot));
+}
+
+void SnapshotHandler::list()
+{
+    if (SnapshotHandler::m_snapshots.empty()) {
+        cout << "no snapshot" << '\n';
+
+        return;
+    }
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    for (auto& snapshot : SnapshotHandler::m_snapshots) {
+        cout << dec << snapshot.id << ": " << snapshot.pages.size() << " pages, " << snapshot.copied << " copied, ";
+        cout << fixed << setprecision(2) << snapshot.stored / 1048576.0 << " MB stored" << '\n';
+    }
+
+    cout.copyfmt(state);
+}
+
+// the pages it shares with other snapshots stay with them
+bool SnapshotHandler::remove(int id)
+{
+    auto it = find_if(SnapshotHandler::m_snapshots.begin(), SnapshotHandler::m_snapshots.end(), [id](Snapshot const& snapshot) {
+        return snapshot.id == id;
+    });
+
+    if (it == SnapshotHandler::m_snapshots.end()) return false;
+
+    SnapshotHandler::m_snapshots.erase(it);
+
+    return true;
+}
+
+// a page not written since the latest snapshot is taken from it, the tracee is only read for soft-dirty pages
+// the changed bytes of each page are merged into ranges, a range goes on across page boundaries, -1 is the latest snapshot
+void SnapshotHandler::diff(int id)
+{
+    auto begin = chrono::steady_clock::now();
+
+    if (id == -1 && !SnapshotHandler::m_snapshots.empty()) {
+        id = SnapshotHandler::m_snapshots.back().id;
+    }
+
+    auto it = find_if(SnapshotHandler::m_snapshots.begin(), SnapshotHandler::m_snapshots.end(), [id](Snapshot const& snapshot) {
+        return snapshot.id == id;
+    });
+
+    if (it == SnapshotHandler::m_snapshots.end()) {
+        cerr << "** [diff] error, no snapshot " << id << '\n';
+
+        return;
+    }
+
+    Snapshot const& old = *it;
+    Snapshot const& latest = SnapshotHandler::m_snapshots.back();
+
+    size_t page_size = SnapshotHandler::m_page_size;
+    size_t pages_read = 0, ranges = 0, changed = 0, mappings = 0;
+
+    vector<unsigned char> before(page_size), after, latest_page(page_size);
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << hex;
+
+    vector<map_entry_t> current = SnapshotHandler::mappings();
+
+    for (auto& mapping : old.mappings) {
+        bool found = any_of(current.begin(), current.end(), [&mapping](map_entry_t const& entry) {
+            return entry.range.begin == mapping.range.begin;
+        });
+
+        if (!found) {
+            cout << "unmapped " << mapping.range.begin << '-' << mapping.range.end << ' ' << mapping.name << '\n';
+        }
+    }
+
+    for (auto& mapping : current) {
+        bool known = any_of(old.mappings.begin(), old.mappings.end(), [&mapping](map_entry_t const& entry) {
+            return entry.range.begin == mapping.range.begin;
+        });
+
+        vector<unsigned long> entries;
+
+        if (SnapshotHandler::tracked()) {
+            entries = SnapshotHandler::pagemap(mapping);
+        }
+
+        // the first page read of a run brings in the rest of it
+        unsigned long window = 0;
+        size_t window_size = 0;
+
+        vector<pair<unsigned long, unsigned long>> changes;
+
+        for (unsigned long address = mapping.range.begin; address < mapping.range.end; address += page_size) {
+            size_t index = (address - mapping.range.begin) / page_size;
+
+            auto in_old = old.pages.find(address);
+            auto in_latest = latest.pages.find(address);
+
+            bool clean = (!entries.empty() && (entries[index] & PAGEMAP_SOFT_DIRTY) == 0 && in_latest != latest.pages.end());
+
+            unsigned char const* now = NULL;
+
+            if (clean) {
+                // unchanged since the latest snapshot, which shares this very page with the old one
+                if (in_old != old.pages.end() && in_old->second == in_latest->second) continue;
+
+                SnapshotHandler::decompress(in_latest->second, latest_page.data());
+                now = latest_page.data();
+            }
+            else {
+                if (address >= window + window_size * page_size || address < window) {
+                    size_t count = 1;
+
+                    while (address + count * page_size < mapping.range.end && count < RUN_PAGES) {
+                        size_t next = index + count;
+                        bool next_clean = (!entries.empty() && (entries[next] & PAGEMAP_SOFT_DIRTY) == 0 && latest.pages.count(address + count * page_size) != 0);
+
+                        if (next_clean) break;
+
+                        count += 1;
+                    }
+
+                    window = address;
+                    window_size = count;
+                    after.resize(count * page_size);
+
+                    SnapshotHandler::read(window, after.data(), after.size());
+
+                    pages_read += count;
+                }
+
+                now = after.data() + (address - window);
+            }
+
+            SnapshotHandler::decompress(in_old == old.pages.end() ? NULL : in_old->second, before.data());
+
+            for (size_t offset = SnapshotHandler::compare(before.data(), now, 0); offset < page_size; offset = SnapshotHandler::compare(before.data(), now, offset)) {
+                size_t end = offset;
+
+                // changes less than a word apart are one range
+                for (size_t same = 0; end < page_size && same < sizeof(unsigned long); end++) {
+                    same = (before[end] == now[end] ? same + 1 : 0);
+                }
+
+                while (end > offset && before[end - 1] == now[end - 1]) {
+                    end -= 1;
+                }
+
+                if (!changes.empty() && changes.back().second == address + offset) {
+                    changes.back().second = address + end;
+                }
+                else {
+                    changes.push_back(make_pair(address + offset, address + end));
+                }
+
+                offset = end;
+            }
+        }
+
+        if (changes.empty()) continue;
+
+        mappings += 1;
+
+        cout << mapping.range.begin << '-' << mapping.range.end << ' ' << (mapping.name.empty() ? "[anonymous]" : mapping.name) << (known ? "" : " (new)") << '\n';
+
+        for (auto& [low, high] : changes) {
+            vector<unsigned char> previous(min(high - low, PREVIEW)), present(previous.size());
+
+            unsigned long page = low - low % page_size;
+            auto in_old = old.pages.find(page);
+
+            // the preview is taken from the snapshot and the tracee again, a range may start in an earlier page
+            SnapshotHandler::decompress(in_old == old.pages.end() ? NULL : in_old->second, before.data());
+            SnapshotHandler::read(low, present.data(), present.size());
+
+            for (size_t i = 0; i < previous.size(); i++) {
+                unsigned long address = low + i;
+
+                if (address - page >= page_size) {
+                    page += page_size;
+                    in_old = old.pages.find(page);
+
+                    SnapshotHandler::decompress(in_old == old.pages.end() ? NULL : in_old->second, before.data());
+                }
+
+                previous[i] = before[address - page];
+            }
+
+            cout << "  " << low << '-' << high << " (" << dec << high - low << " bytes):" << hex;
+
+            for (auto byte : previous) {
+                cout << ' ' << setw(2) << setfill('0') << (unsigned int)byte;
+            }
+
+            cout << " ->";
+
+            for (auto byte : present) {
+                cout << ' ' << setw(2) << setfill('0') << (unsigned int)byte;
+            }
+
+            cout << (high - low > PREVIEW ? " ..." : "") << setfill(' ') << '\n';
+
+            ranges += 1;
+            changed += high - low;
+        }
+    }
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - begin;
+
+    cout << "** diff against snapshot " << dec << old.id << ": " << ranges << " ranges, " << changed << " bytes changed in " << mappings << " mappings, ";
+    cout << pages_read << " pages read, " << fixed << setprecision(2) << elapsed.count() << " ms" << '\n';
+
+    cout.copyfmt(state);
+}
@@ -0,0 +1,271 @@
+#include "SymbolHandler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <regex>
+#include <sstream>
+#include <cstring>
+#include <fnmatch.h>
+
+#include "ElfHandler.h"
+
+using namespace std;
+
+vector<Symbol> SymbolHandler::m_symbols;
+vector<pair<unsigned int, unsigned int>> SymbolHandler::m_names;
+
+SymbolHandler::SymbolHandler()
+{
+}
+
+SymbolHandler::~SymbolHandler()
+{
+}
+
+// defined functions and objects only, section / file symbols and imports carry no useful address
+// addresses are those in the process, shifted by the load bias of a position-independent executable
+void SymbolHandler::add(string_view table)
+{
+    SymbolTable symbols = ElfHandler::symbols(table);
+
+    for (size_t i = 0; i < symbols.count; i++) {
+        Elf64_Sym const& sym = symbols.symbols[i];
+        unsigned char type = ELF64_ST_TYPE(sym.st_info);
+
+        if (sym.st_shndx == SHN_UNDEF || sym.st_value == 0 || sym.st_name == 0 || sym.st_name >= symbols.strings_size) continue;
+        if (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE && type != STT_GNU_IFUNC) continue;
+
+        char const* name = symbols.strings + sym.st_name;
+
+        SymbolHandler::m_symbols.push_back(
+            Symbol {
+                .address = sym.st_value + ElfHandler::bias(),
+                .size = sym.st_size,
+                .name = string_view(name, strnlen(name, symbols.strings_size - sym.st_name)),
+                .type = type
+            }
+        );
+    }
+}
+
+void SymbolHandler::load()
+{
+    SymbolHandler::unload();
+
+    SymbolHandler::m_symbols.reserve(ElfHandler::symbols(".symtab").count + ElfHandler::symbols(".dynsym").count);
+
+    SymbolHandler::add(".symtab");
+    SymbolHandler::add(".dynsym");
+
+    // sort compact keys instead of whole symbols, sized functions first at an address so they win over labels when symbolizing
+    struct Key {
+        unsigned long address;
+        unsigned int rank;
+        unsigned int index;
+    };
+
+    vector<Key> keys(SymbolHandler::m_symbols.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        Symbol const& symbol = SymbolHandler::m_symbols[i];
+
+        keys[i] = Key {
+            .address = symbol.address,
+            .rank = (unsigned int)(((symbol.type != STT_FUNC) << 1) | (symbol.size == 0)),
+            .index = (unsigned int)i
+        };
+    }
+
+    sort(keys.begin(), keys.end(), [](Key const& lhs, Key const& rhs) {
+        if (lhs.address != rhs.address) return lhs.address < rhs.address;
+        if (lhs.rank != rhs.rank) return lhs.rank < rhs.rank;
+
+        return SymbolHandler::m_symbols[lhs.index].name < SymbolHandler::m_symbols[rhs.index].name;
+    });
+
+    // .dynsym mostly repeats .symtab
+    vector<Symbol> symbols;
+    symbols.reserve(keys.size());
+
+    for (auto& key : keys) {
+        Symbol const& symbol = SymbolHandler::m_symbols[key.index];
+
+        if (!symbols.empty() && symbols.back().address == symbol.address && symbols.back().name == symbol.name) continue;
+
+        symbols.push_back(symbol);
+    }
+
+    SymbolHandler::m_symbols.swap(symbols);
+
+    // open addressing over (hash, index + 1) pairs, index 0 marks an empty bucket, at most half full
+    size_t buckets = 16;
+    while (buckets < SymbolHandler::m_symbols.size() * 2) {
+        buckets <<= 1;
+    }
+
+    SymbolHandler::m_names.assign(buckets, make_pair(0U, 0U));
+
+    for (size_t i = 0; i < SymbolHandler::m_symbols.size(); i++) {
+        size_t hash_value = hash<string_view>()(SymbolHandler::m_symbols[i].name);
+        size_t bucket = hash_value & (buckets - 1);
+
+        while (SymbolHandler::m_names[bucket].second != 0) {
+            auto& entry = SymbolHandler::m_names[bucket];
+
+            // the first, lowest addressed, symbol of a name wins
+            if (entry.first == (unsigned int)hash_value && SymbolHandler::m_symbols[entry.second - 1].name == SymbolHandler::m_symbols[i].name) break;
+
+            bucket = (bucket + 1) & (buckets - 1);
+        }
+
+        if (SymbolHandler::m_names[bucket].second == 0) {
+            SymbolHandler::m_names[bucket] = make_pair((unsigned int)hash_value, (unsigned int)(i + 1));
+        }
+    }
+}
+
+void SymbolHandler::unload()
+{
+    SymbolHandler::m_symbols.clear();
+    SymbolHandler::m_names.clear();
+}
+
+int SymbolHandler::size()
+{
+    return SymbolHandler::m_symbols.size();
+}
+
+// symbol covering address, unsized symbols cover everything up to the next symbol
+Symbol const* SymbolHandler::find(unsigned long address)
+{
+    auto it = upper_bound(SymbolHandler::m_symbols.begin(), SymbolHandler::m_symbols.end(), address, [](unsigned long lhs, Symbol const& rhs) {
+        return lhs < rhs.address;
+    });
+
+    if (it == SymbolHandler::m_symbols.begin()) return NULL;
+
+    unsigned long begin = (it - 1)->address;
+
+    // step back to the preferred symbol at that address
+    while (it != SymbolHandler::m_symbols.begin() && (it - 1)->address == begin) {
+        it--;
+    }
+
+    if (it->size != 0 && address >= it->address + it->size) return NULL;
+
+    return &(*it);
+}
+
+Symbol const* SymbolHandler::find(string_view name)
+{
+    if (SymbolHandler::m_names.empty()) return NULL;
+
+    size_t buckets = SymbolHandler::m_names.size();
+    size_t hash_value = hash<string_view>()(name);
+    size_t bucket = hash_value & (buckets - 1);
+
+    while (SymbolHandler::m_names[bucket].second != 0) {
+        auto& entry = SymbolHandler::m_names[bucket];
+
+        if (entry.first == (unsigned int)hash_value && SymbolHandler::m_symbols[entry.second - 1].name == name) return &SymbolHandler::m_symbols[entry.second - 1];
+
+        bucket = (bucket + 1) & (buckets - 1);
+    }
+
+    return NULL;
+}
+
+// /regex/ or a shell glob, a regex that does not compile matches nothing
+vector<Symbol const*> SymbolHandler::match(string pattern)
+{
+    vector<Symbol const*> symbols;
+
+    if (pattern.size() >= 2 && pattern.front() == '/' && pattern.back() == '/') {
+        regex expression;
+
+        try {
+            expression.assign(pattern.substr(1, pattern.size() - 2));
+        }
+        catch (regex_error const& e) {
+            cerr << "** [symbols] error, bad regex" << '\n';
+
+            return symbols;
+        }
+
+        for (auto& symbol : SymbolHandler::m_symbols) {
+            if (regex_search(symbol.name.begin(), symbol.name.end(), expression)) {
+                symbols.push_back(&symbol);
+            }
+        }
+    }
+    else {
+        for (auto& symbol : SymbolHandler::m_symbols) {
+            if (fnmatch(pattern.c_str(), string(symbol.name).c_str(), 0) == 0) {
+                symbols.push_back(&symbol);
+            }
+        }
+    }
+
+    return symbols;
+}
+
+// "name" or "name+0x10", empty if no symbol covers address
+string SymbolHandler::symbolize(unsigned long address)
+{
+    Symbol const* symbol = SymbolHandler::find(address);
+
+    if (symbol == NULL) return "";
+
+    stringstream ss;
+    ss << symbol->name;
+
+    if (address != symbol->address) {
+        ss << "+0x" << hex << (address - symbol->address);
+    }
+
+    return ss.str();
+}
+
+// symbol name, symbol+offset or hex address, names come first so a function called add or face is not taken for 0xadd or 0xface
+// only a 0x prefix makes it an address no matter which symbols exist
+bool SymbolHandler::resolve(string expression, unsigned long& address)
+{
+    size_t end = 0;
+
+    if (expression.compare(0, 2, "0x") != 0) {
+        string name = expression;
+        unsigned long offset = 0;
+        bool valid = true;
+        auto plus = expression.find('+');
+
+        if (plus != string::npos) {
+            try {
+                offset = stoul(expression.substr(plus + 1), &end, 0);
+                valid = (end == expression.size() - plus - 1);
+            }
+            catch (...) {
+                valid = false;
+            }
+
+            name = expression.substr(0, plus);
+        }
+
+        Symbol const* symbol = (valid ? SymbolHandler::find(name) : NULL);
+
+        if (symbol != NULL) {
+            address = symbol->address + offset;
+
+            return true;
+        }
+    }
+
+    try {
+        address = stoul(expression, &end, 16);
+
+        if (end == expression.size()) return true;
+    }
+    catch (...) {
+    }
+
+    return false;
+}
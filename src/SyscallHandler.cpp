@@ -0,0 +1,299 @@
+#include "SyscallHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+
+#include "SyscallTable.h"
+
+using namespace std;
+
+// system calls kept for "syscalls log", the oldest are overwritten
+static constexpr size_t RECORD_CAPACITY = 1 << 16;
+
+// a BPF conditional jump reaches at most 255 instructions ahead
+static constexpr size_t MAX_SELECTED = 255;
+
+vector<long> SyscallHandler::m_selected;
+unordered_map<pid_t, SyscallRecord> SyscallHandler::m_inflight;
+vector<SyscallRecord> SyscallHandler::m_records;
+unsigned long SyscallHandler::m_recorded = 0;
+map<long, SyscallStat> SyscallHandler::m_stats;
+
+static unsigned long now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SyscallHandler::SyscallHandler()
+{
+}
+
+SyscallHandler::~SyscallHandler()
+{
+}
+
+// a name from the table or a plain number, -1 if neither
+long SyscallHandler::number(string_view name)
+{
+    for (auto& descriptor : syscall_table) {
+        if (descriptor.name == name) return descriptor.number;
+    }
+
+    if (name.empty() || name.find_first_not_of("0123456789") != string_view::npos) return -1;
+
+    return strtol(string(name).c_str(), NULL, 10);
+}
+
+string SyscallHandler::name(long number)
+{
+    auto it = lower_bound(syscall_table.begin(), syscall_table.end(), number, [](SyscallDescriptor const& lhs, long rhs) {
+        return lhs.number < rhs;
+    });
+
+    if (it != syscall_table.end() && it->number == number) return string(it->name);
+
+    return "syscall_" + to_string(number);
+}
+
+// names may also be given as one comma separated list, nothing is selected if one of them is unknown
+bool SyscallHandler::select(vector<string> const& names)
+{
+    vector<long> selected;
+
+    for (auto& list : names) {
+        size_t begin = 0;
+
+        while (begin <= list.size()) {
+            size_t end = min(list.find(',', begin), list.size());
+            string name = list.substr(begin, end - begin);
+
+            begin = end + 1;
+
+            if (name.empty()) continue;
+
+            long number = SyscallHandler::number(name);
+
+            if (number < 0) {
+                cerr << "** [syscalls] error, unknown system call '" << name << "'" << '\n';
+
+                return false;
+            }
+
+            selected.push_back(number);
+        }
+    }
+
+    sort(selected.begin(), selected.end());
+    selected.erase(unique(selected.begin(), selected.end()), selected.end());
+
+    if (selected.size() > MAX_SELECTED) {
+        cerr << "** [syscalls] error, at most " << MAX_SELECTED << " system calls can be selected" << '\n';
+
+        return false;
+    }
+
+    SyscallHandler::m_selected = selected;
+
+    return true;
+}
+
+vector<long> const& SyscallHandler::selected()
+{
+    return SyscallHandler::m_selected;
+}
+
+// runs in the child between fork and execvp, once the tracer has seized it with PTRACE_O_TRACESECCOMP,
+// a traced call without such a tracer would fail with ENOSYS
+bool SyscallHandler::install()
+{
+    if (SyscallHandler::m_selected.empty()) return true;
+
+    size_t count = SyscallHandler::m_selected.size();
+    vector<struct sock_filter> filter;
+
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)));
+
+    // a match jumps over the remaining compares and the allow to the trace at the end
+    for (size_t i = 0; i < count; i++) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned int)SyscallHandler::m_selected[i], (unsigned char)(count - i), 0));
+    }
+
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+
+    struct sock_fprog program = { (unsigned short)filter.size(), filter.data() };
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 || prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) != 0) {
+        cerr << "** [seccomp] error, install filter" << '\n';
+
+        return false;
+    }
+
+    return true;
+}
+
+void SyscallHandler::enter(pid_t tid, struct user_regs_struct const& regs)
+{
+    SyscallRecord& record = SyscallHandler::m_inflight[tid];
+
+    record = SyscallRecord { tid, (long)regs.orig_rax, { regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9 }, 0, 0, 0 };
+    record.begin = now();
+}
+
+// a syscall-exit stop without a seccomp stop before it is not ours and ignored
+void SyscallHandler::leave(pid_t tid, struct user_regs_struct const& regs)
+{
+    unsigned long end = now();
+
+    auto it = SyscallHandler::m_inflight.find(tid);
+
+    if (it == SyscallHandler::m_inflight.end()) return;
+
+    SyscallRecord record = it->second;
+    SyscallHandler::m_inflight.erase(it);
+
+    record.result = regs.rax;
+    record.duration = end - record.begin;
+
+    if (SyscallHandler::m_records.size() < RECORD_CAPACITY) {
+        SyscallHandler::m_records.push_back(record);
+    }
+    else {
+        SyscallHandler::m_records[SyscallHandler::m_recorded % RECORD_CAPACITY] = record;
+    }
+
+    SyscallHandler::m_recorded += 1;
+
+    auto [stat, inserted] = SyscallHandler::m_stats.try_emplace(record.number, SyscallStat {});
+
+    if (inserted) {
+        stat->second.min = ~0UL;
+    }
+
+    SyscallStat& value = stat->second;
+    unsigned long microseconds = record.duration / 1000;
+    size_t bucket = 0;
+
+    while (bucket < SyscallStat::BUCKETS - 1 && (1UL << bucket) <= microseconds) {
+        bucket += 1;
+    }
+
+    value.count += 1;
+    value.errors += (record.result < 0 && record.result > -4096);
+    value.total += record.duration;
+    value.min = min(value.min, record.duration);
+    value.max = max(value.max, record.duration);
+    value.buckets[bucket] += 1;
+}
+
+bool SyscallHandler::inflight(pid_t tid)
+{
+    return SyscallHandler::m_inflight.find(tid) != SyscallHandler::m_inflight.end();
+}
+
+void SyscallHandler::clear()
+{
+    SyscallHandler::m_inflight.clear();
+    SyscallHandler::m_records.clear();
+    SyscallHandler::m_recorded = 0;
+    SyscallHandler::m_stats.clear();
+}
+
+// strace -c layout sorted by total time, followed by a latency histogram per system call
+void SyscallHandler::report()
+{
+    if (SyscallHandler::m_stats.empty()) {
+        cout << "** no system calls recorded" << '\n';
+
+        return;
+    }
+
+    vector<pair<long, SyscallStat const*>> stats;
+    unsigned long total = 0, calls = 0, errors = 0;
+
+    for (auto& [number, stat] : SyscallHandler::m_stats) {
+        stats.push_back(make_pair(number, &stat));
+
+        total += stat.total;
+        calls += stat.count;
+        errors += stat.errors;
+    }
+
+    sort(stats.begin(), stats.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.second->total > rhs.second->total;
+    });
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    string line = "------ ----------- ----------- --------- --------- ----------------";
+
+    cout << "% time     seconds  usecs/call     calls    errors syscall" << '\n';
+    cout << line << '\n';
+    cout << fixed;
+
+    for (auto& [number, stat] : stats) {
+        cout << setw(6) << setprecision(2) << (total > 0 ? 100.0 * stat->total / total : 0.0) << ' ';
+        cout << setw(11) << setprecision(6) << stat->total / 1e9 << ' ';
+        cout << setw(11) << stat->total / stat->count / 1000 << ' ';
+        cout << setw(9) << stat->count << ' ' << setw(9) << stat->errors << ' ' << SyscallHandler::name(number) << '\n';
+    }
+
+    cout << line << '\n';
+    cout << setw(6) << setprecision(2) << 100.0 << ' ' << setw(11) << setprecision(6) << total / 1e9 << ' ' << setw(11) << "" << ' ';
+    cout << setw(9) << calls << ' ' << setw(9) << errors << ' ' << "total" << '\n';
+
+    for (auto& [number, stat] : stats) {
+        size_t first = 0, last = SyscallStat::BUCKETS - 1;
+
+        while (stat->buckets[first] == 0) first++;
+        while (stat->buckets[last] == 0) last--;
+
+        unsigned long peak = *max_element(stat->buckets, stat->buckets + SyscallStat::BUCKETS);
+
+        cout << '\n' << SyscallHandler::name(number) << " (us), min " << setprecision(1) << stat->min / 1000.0 << ", max " << stat->max / 1000.0 << '\n';
+
+        for (size_t i = first; i <= last; i++) {
+            unsigned long low = (i == 0 ? 0 : 1UL << (i - 1));
+
+            cout << setw(10) << low << " .. " << setw(8) << left << (1UL << i) << right << setw(9) << stat->buckets[i] << " |";
+            cout << string((stat->buckets[i] * 40 + peak - 1) / peak, '*') << '\n';
+        }
+    }
+
+    cout.copyfmt(state);
+}
+
+// "tid name(args) = result <seconds>", arguments in hex as the number each call takes is not known here
+void SyscallHandler::log(size_t count)
+{
+    count = min({ count, (size_t)SyscallHandler::m_recorded, RECORD_CAPACITY });
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    for (unsigned long i = SyscallHandler::m_recorded - count; i < SyscallHandler::m_recorded; i++) {
+        SyscallRecord const& record = SyscallHandler::m_records[i % RECORD_CAPACITY];
+
+        cout << dec << record.tid << ' ' << SyscallHandler::name(record.number) << '(' << hex;
+
+        for (size_t j = 0; j < 6; j++) {
+            cout << (j == 0 ? "0x" : ", 0x") << record.args[j];
+        }
+
+        cout << ") = " << dec << record.result << " <" << fixed << setprecision(6) << record.duration / 1e9 << ">" << '\n';
+    }
+
+    cout.copyfmt(state);
+}
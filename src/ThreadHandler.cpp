@@ -0,0 +1,181 @@
+#include "ThreadHandler.h"
+
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/user.h>
+
+#include "BreakpointHandler.h"
+#include "MemoryHandler.h"
+#include "SyscallHandler.h"
+
+using namespace std;
+
+map<pid_t, Thread> ThreadHandler::m_threads;
+pid_t ThreadHandler::m_current = -1;
+bool ThreadHandler::m_non_stop = false;
+
+ThreadHandler::ThreadHandler()
+{
+}
+
+ThreadHandler::~ThreadHandler()
+{
+}
+
+void ThreadHandler::clear()
+{
+    ThreadHandler::m_threads.clear();
+    ThreadHandler::m_current = -1;
+}
+
+Thread* ThreadHandler::add(pid_t tid, THREAD_STATE state)
+{
+    Thread& thread = ThreadHandler::m_threads[tid];
+
+    thread = Thread { tid, state, false, 0 };
+
+    return &thread;
+}
+
+void ThreadHandler::remove(pid_t tid)
+{
+    ThreadHandler::m_threads.erase(tid);
+}
+
+Thread* ThreadHandler::get(pid_t tid)
+{
+    auto it = ThreadHandler::m_threads.find(tid);
+
+    if (it == ThreadHandler::m_threads.end()) return NULL;
+
+    return &it->second;
+}
+
+vector<Thread const*> ThreadHandler::list()
+{
+    vector<Thread const*> threads;
+
+    for (auto& [tid, thread] : ThreadHandler::m_threads) {
+        threads.push_back(&thread);
+    }
+
+    return threads;
+}
+
+size_t ThreadHandler::size()
+{
+    return ThreadHandler::m_threads.size();
+}
+
+pid_t ThreadHandler::current()
+{
+    return ThreadHandler::m_current;
+}
+
+void ThreadHandler::select(pid_t tid)
+{
+    ThreadHandler::m_current = tid;
+}
+
+bool ThreadHandler::non_stop()
+{
+    return ThreadHandler::m_non_stop;
+}
+
+void ThreadHandler::set_non_stop(bool non_stop)
+{
+    ThreadHandler::m_non_stop = non_stop;
+}
+
+// a stopped thread whose stop still has to be reported, NULL if there is none
+Thread* ThreadHandler::pending()
+{
+    for (auto& [tid, thread] : ThreadHandler::m_threads) {
+        if (thread.pending) return &thread;
+    }
+
+    return NULL;
+}
+
+// interrupt every other running thread and wait until it stopped
+// a thread that stopped for another reason first keeps that stop pending, the interrupt then arrives after its next resume
+void ThreadHandler::stop_others()
+{
+    for (auto& [tid, thread] : ThreadHandler::m_threads) {
+        if (tid != ThreadHandler::m_current && thread.state == THREAD_STATE::THREAD_RUNNING) {
+            ptrace(PTRACE_INTERRUPT, tid, 0, 0);
+        }
+    }
+
+    for (auto it = ThreadHandler::m_threads.begin(); it != ThreadHandler::m_threads.end();) {
+        Thread& thread = it->second;
+
+        if (thread.tid == ThreadHandler::m_current || thread.state != THREAD_STATE::THREAD_RUNNING) {
+            it++;
+
+            continue;
+        }
+
+        int status = 0;
+
+        if (waitpid(thread.tid, &status, __WALL) != thread.tid) {
+            it = ThreadHandler::m_threads.erase(it);
+
+            continue;
+        }
+
+        thread.state = THREAD_STATE::THREAD_STOPPED;
+
+        if (!WIFSTOPPED(status) || (status >> 16) != PTRACE_EVENT_STOP || WSTOPSIG(status) != SIGTRAP) {
+            thread.pending = true;
+            thread.status = status;
+        }
+
+        it++;
+    }
+}
+
+// continue every other stopped thread that has nothing pending, one sitting on an armed breakpoint
+// first steps over it with the original byte put back, which is safe while the others are still stopped
+// one inside a traced system call goes on with PTRACE_SYSCALL so its exit is still caught
+void ThreadHandler::resume_others()
+{
+    for (auto& [tid, thread] : ThreadHandler::m_threads) {
+        if (tid == ThreadHandler::m_current || thread.state != THREAD_STATE::THREAD_STOPPED || thread.pending) continue;
+
+        struct user_regs_struct regs;
+        Breakpoint const* breakpoint = NULL;
+
+        bool inflight = SyscallHandler::inflight(tid);
+
+        // a breakpoint right after the system call has not run yet and is hit once it returns
+        if (!inflight && ptrace(PTRACE_GETREGS, tid, 0, &regs) == 0) {
+            breakpoint = BreakpointHandler::find(regs.rip);
+        }
+
+        if (breakpoint != NULL && breakpoint->enabled) {
+            unsigned char code = breakpoint->code;
+            unsigned char int3 = 0xcc;
+            int status = 0;
+
+            MemoryHandler::write(breakpoint->address, &code, 1);
+
+            ptrace(PTRACE_SINGLESTEP, tid, 0, 0);
+            waitpid(tid, &status, __WALL);
+
+            MemoryHandler::write(breakpoint->address, &int3, 1);
+
+            if (!WIFSTOPPED(status) || WSTOPSIG(status) != SIGTRAP) {
+                thread.pending = true;
+                thread.status = status;
+
+                continue;
+            }
+        }
+
+        ptrace((inflight ? PTRACE_SYSCALL : PTRACE_CONT), tid, 0, 0);
+        thread.state = THREAD_STATE::THREAD_RUNNING;
+    }
+
+    MemoryHandler::invalidate();
+}
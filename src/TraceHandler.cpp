@@ -0,0 +1,95 @@
+#include "TraceHandler.h"
+
+#include <cstring>
+
+using namespace std;
+
+// records are staged here and written out whenever it fills up, so the stepping loop never waits on small writes
+static constexpr size_t BUFFER_RECORDS = 1 << 16;
+
+ofstream TraceHandler::m_file;
+vector<RegisterDescriptor const*> TraceHandler::m_registers;
+vector<unsigned long> TraceHandler::m_buffer;
+size_t TraceHandler::m_used = 0;
+unsigned long TraceHandler::m_count = 0;
+
+TraceHandler::TraceHandler()
+{
+}
+
+TraceHandler::~TraceHandler()
+{
+    TraceHandler::close();
+}
+
+void TraceHandler::drain()
+{
+    TraceHandler::m_file.write((char const*)TraceHandler::m_buffer.data(), TraceHandler::m_used * sizeof(unsigned long));
+    TraceHandler::m_used = 0;
+}
+
+bool TraceHandler::open(string path, vector<RegisterDescriptor const*> const& registers, unsigned long bias)
+{
+    TraceHandler::close();
+
+    TraceHandler::m_file.open(path, ios::out | ios::binary | ios::trunc);
+
+    if (!TraceHandler::m_file.is_open()) return false;
+
+    TraceHandler::m_registers = registers;
+    TraceHandler::m_buffer.resize(BUFFER_RECORDS * (1 + registers.size()));
+    TraceHandler::m_used = 0;
+    TraceHandler::m_count = 0;
+
+    TraceHeader header;
+    memcpy(header.magic, "SDBTRACE", sizeof(header.magic));
+    header.version = 2;
+    header.count = registers.size();
+
+    TraceHandler::m_file.write((char const*)&header, sizeof(header));
+
+    for (auto reg : registers) {
+        char name[TraceHandler::NAME_SIZE] = {};
+        memcpy(name, reg->name.data(), min(reg->name.size(), TraceHandler::NAME_SIZE - 1));
+
+        TraceHandler::m_file.write(name, sizeof(name));
+    }
+
+    TraceHandler::m_file.write((char const*)&bias, sizeof(bias));
+
+    return TraceHandler::m_file.good();
+}
+
+void TraceHandler::record(struct user_regs_struct const& regs)
+{
+    if (TraceHandler::m_used == TraceHandler::m_buffer.size()) {
+        TraceHandler::drain();
+    }
+
+    unsigned long* record = TraceHandler::m_buffer.data() + TraceHandler::m_used;
+
+    record[0] = regs.rip;
+
+    for (size_t i = 0; i < TraceHandler::m_registers.size(); i++) {
+        RegisterDescriptor const* reg = TraceHandler::m_registers[i];
+
+        record[i + 1] = (*(unsigned long const*)((char const*)&regs + reg->offset) >> reg->shift) & reg->mask;
+    }
+
+    TraceHandler::m_used += 1 + TraceHandler::m_registers.size();
+    TraceHandler::m_count += 1;
+}
+
+// flush what is left and return the number of records written since open()
+unsigned long TraceHandler::close()
+{
+    if (!TraceHandler::m_file.is_open()) return 0;
+
+    TraceHandler::drain();
+    TraceHandler::m_file.close();
+
+    TraceHandler::m_buffer.clear();
+    TraceHandler::m_buffer.shrink_to_fit();
+
+    return TraceHandler::m_count;
+}
@@ -0,0 +1,324 @@
+#include "TrampolineHandler.h"
+
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ptools.h"
+#include "MemoryHandler.h"
+#include "RegisterHandler.h"
+#include "BreakpointHandler.h"
+
+using namespace std;
+
+// one slot holds the displaced instruction (at most 15 bytes) and the absolute jumps out of it
+static const unsigned long SLOT_SIZE = 32;
+static const unsigned long SCRATCH_SIZE = 0x10000;
+
+pid_t TrampolineHandler::m_pid = -1;
+csh TrampolineHandler::m_handle = 0;
+unsigned long TrampolineHandler::m_near = 0;
+unsigned long TrampolineHandler::m_scratch = 0;
+bool TrampolineHandler::m_failed = false;
+vector<unsigned long> TrampolineHandler::m_owners;
+vector<unsigned long> TrampolineHandler::m_free;
+unordered_map<unsigned long, TrampolineHandler::Slot> TrampolineHandler::m_slots;
+
+TrampolineHandler::TrampolineHandler()
+{
+}
+
+TrampolineHandler::~TrampolineHandler()
+{
+    TrampolineHandler::detach();
+}
+
+// near is an address in the program's code, the scratch page is placed close to it so RIP-relative operands stay reachable
+void TrampolineHandler::attach(pid_t pid, unsigned long near)
+{
+    TrampolineHandler::detach();
+
+    if (cs_open(CS_ARCH_X86, CS_MODE_64, &TrampolineHandler::m_handle) != CS_ERR_OK) {
+        cerr << "** [capstone] error, cs_open fail" << '\n';
+
+        return;
+    }
+
+    cs_option(TrampolineHandler::m_handle, CS_OPT_DETAIL, CS_OPT_ON);
+
+    TrampolineHandler::m_pid = pid;
+    TrampolineHandler::m_near = near;
+}
+
+void TrampolineHandler::detach()
+{
+    if (TrampolineHandler::m_pid != -1) {
+        cs_close(&TrampolineHandler::m_handle);
+    }
+
+    TrampolineHandler::m_pid = -1;
+    TrampolineHandler::m_near = 0;
+    TrampolineHandler::m_scratch = 0;
+    TrampolineHandler::m_failed = false;
+    TrampolineHandler::m_owners.clear();
+    TrampolineHandler::m_free.clear();
+    TrampolineHandler::m_slots.clear();
+}
+
+// the scratch page is mapped inside the tracee on first use by injecting an mmap
+bool TrampolineHandler::allocate()
+{
+    if (TrampolineHandler::m_scratch != 0) return true;
+    if (TrampolineHandler::m_failed || TrampolineHandler::m_pid == -1) return false;
+
+    unsigned long hint = (TrampolineHandler::m_near > 0x1000000 ? TrampolineHandler::m_near - 0x1000000 : 0x100000) & ~0xfffUL;
+
+    long result = inject_syscall(TrampolineHandler::m_pid, SYS_mmap, { hint, SCRATCH_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, (unsigned long)-1, 0 });
+
+    if (result < 0 && result > -4096) {
+        cerr << "** [breakpoint] error, no scratch page, breakpoints are re-armed by single-stepping" << '\n';
+
+        TrampolineHandler::m_failed = true;
+
+        return false;
+    }
+
+    TrampolineHandler::m_scratch = result;
+
+    for (unsigned long offset = SCRATCH_SIZE; offset > 0; offset -= SLOT_SIZE) {
+        TrampolineHandler::m_free.push_back(TrampolineHandler::m_scratch + offset - SLOT_SIZE);
+    }
+
+    TrampolineHandler::m_owners.assign(SCRATCH_SIZE / SLOT_SIZE, 0);
+
+    return true;
+}
+
+static void append_jump(vector<unsigned char>& code, unsigned long target)
+{
+    // jmp qword ptr [rip + 0] followed by the absolute target
+    unsigned char jump[] = { 0xff, 0x25, 0x00, 0x00, 0x00, 0x00 };
+
+    code.insert(code.end(), jump, jump + sizeof(jump));
+    code.insert(code.end(), (unsigned char*)&target, (unsigned char*)&target + sizeof(target));
+}
+
+TrampolineHandler::Slot TrampolineHandler::build(unsigned long address, unsigned char code)
+{
+    Slot slot = { SLOT_NONE, 0, 0, {} };
+
+    unsigned char bytes[16];
+    size_t n = MemoryHandler::read(address, bytes, sizeof(bytes));
+
+    if (n == 0) return slot;
+
+    // the instruction as it was before any int3, including breakpoints that overlap its tail
+    bytes[0] = code;
+    for (size_t i = 1; i < n; i++) {
+        Breakpoint const* breakpoint = BreakpointHandler::find(address + i);
+
+        if (breakpoint != NULL && breakpoint->enabled) {
+            bytes[i] = breakpoint->code;
+        }
+    }
+
+    cs_insn* insn;
+    if (cs_disasm(TrampolineHandler::m_handle, bytes, n, address, 1, &insn) != 1) return slot;
+
+    cs_x86 const& x86 = insn->detail->x86;
+    unsigned long next = address + insn->size;
+    bool relative = (x86.op_count == 1 && x86.operands[0].type == X86_OP_IMM);
+
+    // a call is emulated by pushing the return address, a displaced one would return into the scratch page
+    if (cs_insn_group(TrampolineHandler::m_handle, insn, CS_GRP_CALL)) {
+        if (relative) {
+            slot.type = SLOT_CALL;
+            slot.target = x86.operands[0].imm;
+            slot.exits.push_back(make_pair(0UL, next));
+        }
+
+        cs_free(insn, 1);
+
+        return slot;
+    }
+
+    if (insn->size == 1 && bytes[0] == 0xcc) {
+        cs_free(insn, 1);
+
+        return slot;
+    }
+
+    if (!TrampolineHandler::allocate() || TrampolineHandler::m_free.empty()) {
+        cs_free(insn, 1);
+
+        return slot;
+    }
+
+    unsigned long base = TrampolineHandler::m_free.back();
+    vector<unsigned char> out;
+
+    if (cs_insn_group(TrampolineHandler::m_handle, insn, CS_GRP_JUMP) && relative) {
+        unsigned long target = x86.operands[0].imm;
+
+        if (insn->id == X86_INS_JMP) {
+            append_jump(out, target);
+        }
+        else {
+            // rebuild the condition as a rel8 jcc over the fall-through jump to the taken jump
+            size_t p = 0;
+            bool address_size = false;
+
+            while (p < insn->size && (bytes[p] == 0x2e || bytes[p] == 0x3e || bytes[p] == 0xf2 || bytes[p] == 0xf3 || bytes[p] == 0x66 || bytes[p] == 0x67)) {
+                address_size |= (bytes[p] == 0x67);
+                p++;
+            }
+
+            if (bytes[p] >= 0x70 && bytes[p] <= 0x7f) {
+                out.push_back(bytes[p]);
+            }
+            else if (bytes[p] == 0x0f && p + 1 < insn->size && bytes[p + 1] >= 0x80 && bytes[p + 1] <= 0x8f) {
+                out.push_back(0x70 | (bytes[p + 1] & 0x0f));
+            }
+            else if (bytes[p] >= 0xe0 && bytes[p] <= 0xe3) {
+                if (address_size) out.push_back(0x67);
+
+                out.push_back(bytes[p]);
+            }
+            else {
+                cs_free(insn, 1);
+
+                return slot;
+            }
+
+            out.push_back(14);
+
+            slot.exits.push_back(make_pair(out.size(), next));
+            append_jump(out, next);
+
+            slot.exits.push_back(make_pair(out.size(), target));
+            append_jump(out, target);
+        }
+    }
+    else {
+        out.assign(bytes, bytes + insn->size);
+
+        for (auto i = 0; i < x86.op_count; i++) {
+            if (x86.operands[i].type != X86_OP_MEM || x86.operands[i].mem.base != X86_REG_RIP) continue;
+
+            // keep the effective address: next + disp == base + size + new_disp
+            long displacement = x86.disp + (long)(address - base);
+
+            if (x86.encoding.disp_size != 4 || displacement < INT_MIN || displacement > INT_MAX) {
+                cs_free(insn, 1);
+
+                return slot;
+            }
+
+            int value = displacement;
+            memcpy(out.data() + x86.encoding.disp_offset, &value, sizeof(value));
+        }
+
+        slot.exits.push_back(make_pair(out.size(), next));
+        append_jump(out, next);
+    }
+
+    cs_free(insn, 1);
+
+    if (MemoryHandler::write(base, out.data(), out.size()) != out.size()) return slot;
+
+    TrampolineHandler::m_free.pop_back();
+    TrampolineHandler::m_owners[(base - TrampolineHandler::m_scratch) / SLOT_SIZE] = address;
+
+    slot.type = SLOT_COPY;
+    slot.address = base;
+
+    for (auto& exit : slot.exits) {
+        exit.first += base;
+    }
+
+    return slot;
+}
+
+// the scratch page is shared by all threads, only the injection of the mmap has to run on the selected one
+void TrampolineHandler::select(pid_t pid)
+{
+    if (TrampolineHandler::m_pid == -1) return;
+
+    TrampolineHandler::m_pid = pid;
+}
+
+// forget the slot of a deleted breakpoint so it can be reused
+void TrampolineHandler::release(unsigned long address)
+{
+    auto it = TrampolineHandler::m_slots.find(address);
+
+    if (it == TrampolineHandler::m_slots.end()) return;
+
+    if (it->second.type == SLOT_COPY) {
+        TrampolineHandler::m_owners[(it->second.address - TrampolineHandler::m_scratch) / SLOT_SIZE] = 0;
+        TrampolineHandler::m_free.push_back(it->second.address);
+    }
+
+    TrampolineHandler::m_slots.erase(it);
+}
+
+// the tracee sits on the breakpoint at address (rip == address), code is the byte the int3 replaced
+// DISPLACED: rip now points at the out-of-line copy, EMULATED: the instruction has been carried out already
+// NOT_DISPLACED: the caller has to single-step the original instruction itself
+DISPLACE_TYPE TrampolineHandler::displace(unsigned long address, unsigned char code)
+{
+    if (TrampolineHandler::m_pid == -1) return DISPLACE_TYPE::NOT_DISPLACED;
+
+    auto it = TrampolineHandler::m_slots.find(address);
+
+    if (it == TrampolineHandler::m_slots.end()) {
+        it = TrampolineHandler::m_slots.emplace(address, TrampolineHandler::build(address, code)).first;
+    }
+
+    Slot const& slot = it->second;
+
+    switch (slot.type) {
+        case SLOT_COPY:
+            RegisterHandler::modify().rip = slot.address;
+
+            return DISPLACE_TYPE::DISPLACED;
+        case SLOT_CALL: {
+            struct user_regs_struct& regs = RegisterHandler::modify();
+            unsigned long next = slot.exits[0].second;
+
+            if (MemoryHandler::write(regs.rsp - sizeof(next), &next, sizeof(next)) != sizeof(next)) return DISPLACE_TYPE::NOT_DISPLACED;
+
+            regs.rsp -= sizeof(next);
+            regs.rip = slot.target;
+
+            return DISPLACE_TYPE::EMULATED;
+        }
+        default:
+            return DISPLACE_TYPE::NOT_DISPLACED;
+    }
+}
+
+// a stop at one of the jumps out of a slot is reported at the address that jump leads to
+void TrampolineHandler::fixup()
+{
+    if (TrampolineHandler::m_scratch == 0) return;
+
+    unsigned long rip = RegisterHandler::get().rip;
+
+    if (rip < TrampolineHandler::m_scratch || rip >= TrampolineHandler::m_scratch + SCRATCH_SIZE) return;
+
+    unsigned long owner = TrampolineHandler::m_owners[(rip - TrampolineHandler::m_scratch) / SLOT_SIZE];
+    auto it = TrampolineHandler::m_slots.find(owner);
+
+    if (owner == 0 || it == TrampolineHandler::m_slots.end()) return;
+
+    for (auto& exit : it->second.exits) {
+        if (exit.first == rip) {
+            RegisterHandler::modify().rip = exit.second;
+
+            return;
+        }
+    }
+}
@@ -0,0 +1,257 @@
+#include "TransferHandler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ptools.h"
+#include "BreakpointHandler.h"
+#include "DisassembleHandler.h"
+#include "MemoryHandler.h"
+#include "TrampolineHandler.h"
+
+using namespace std;
+
+// bytes moved with one pread or pwrite, procfs supports neither sendfile nor splice so the data always passes through here
+static constexpr size_t TRANSFER_SIZE = 1 << 20;
+
+TransferHandler::TransferHandler()
+{
+}
+
+TransferHandler::~TransferHandler()
+{
+}
+
+// [address, address + length) has to be covered by mappings without gaps, nothing is transferred otherwise
+bool TransferHandler::mapped(pid_t pid, unsigned long address, size_t length)
+{
+    map<range_t, map_entry_t> maps;
+
+    if (load_maps(pid, maps) < 0) return false;
+
+    unsigned long end = address + length;
+
+    for (auto& [range, mapping] : maps) {
+        if (range.end <= address) continue;
+        if (range.begin > address) break;
+
+        address = range.end;
+
+        if (address >= end) return true;
+    }
+
+    return length == 0;
+}
+
+// new bytes go under the int3 of breakpoints in the range instead of over it, the buffer is modified
+// disasm and next decode from the new bytes too, not from the file they were mapped from
+size_t TransferHandler::write(unsigned long address, unsigned char* buffer, size_t length)
+{
+    BreakpointHandler::overlay(address, buffer, length);
+
+    size_t written = MemoryHandler::write(address, buffer, length);
+
+    BreakpointHandler::restore(address, buffer, written);
+    DisassembleHandler::patch(address, buffer, written);
+
+    return written;
+}
+
+// a displaced copy holds up to 15 bytes after its breakpoint, any that overlaps the range is built again on the next hit
+void TransferHandler::release(unsigned long address, size_t length)
+{
+    for (auto breakpoint : BreakpointHandler::list()) {
+        if (breakpoint->address + 15 >= address && breakpoint->address < address + length) {
+            TrampolineHandler::release(breakpoint->address);
+        }
+    }
+}
+
+void TransferHandler::report(string title, size_t length, double seconds)
+{
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << "** " << title << ", " << dec << length << " bytes, " << fixed << setprecision(2) << seconds * 1000 << " ms, ";
+    cout << length / seconds / 1048576.0 << " MB/s" << '\n';
+
+    cout.copyfmt(state);
+}
+
+bool TransferHandler::save(pid_t pid, unsigned long address, size_t length, string path)
+{
+    auto begin = chrono::steady_clock::now();
+
+    if (!TransferHandler::mapped(pid, address, length)) {
+        cerr << "** [savemem] error, the range is not mapped" << '\n';
+
+        return false;
+    }
+
+    int memory = open(("/proc/" + to_string(pid) + "/mem").c_str(), O_RDONLY | O_CLOEXEC);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (memory < 0 || fd < 0) {
+        cerr << "** [savemem] error, cannot open " << (memory < 0 ? "the memory of the process" : "'" + path + "'") << '\n';
+
+        if (memory >= 0) close(memory);
+        if (fd >= 0) close(fd);
+
+        return false;
+    }
+
+    vector<unsigned char> buffer(min(length, TRANSFER_SIZE));
+    size_t done = 0;
+
+    while (done < length) {
+        size_t chunk = min(length - done, buffer.size());
+        ssize_t n = pread(memory, buffer.data(), chunk, address + done);
+
+        if (n <= 0) break;
+
+        // the file gets the program as it is, not our int3s
+        BreakpointHandler::restore(address + done, buffer.data(), n);
+
+        if (::write(fd, buffer.data(), n) != n) break;
+
+        done += n;
+    }
+
+    close(memory);
+    close(fd);
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+    if (done < length) {
+        cerr << "** [savemem] error, only " << done << " of " << length << " bytes saved to '" << path << "'" << '\n';
+
+        return false;
+    }
+
+    TransferHandler::report("saved to '" + path + "'", length, elapsed.count());
+
+    return true;
+}
+
+bool TransferHandler::load(pid_t pid, unsigned long address, string path)
+{
+    auto begin = chrono::steady_clock::now();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        cerr << "** [loadmem] error, cannot open '" << path << "'" << '\n';
+
+        return false;
+    }
+
+    struct stat file;
+    fstat(fd, &file);
+
+    size_t length = file.st_size;
+
+    if (!TransferHandler::mapped(pid, address, length)) {
+        cerr << "** [loadmem] error, the range is not mapped" << '\n';
+
+        close(fd);
+
+        return false;
+    }
+
+    vector<unsigned char> buffer(min(length, TRANSFER_SIZE));
+    size_t done = 0;
+
+    while (done < length) {
+        ssize_t n = pread(fd, buffer.data(), min(length - done, buffer.size()), done);
+
+        if (n <= 0) break;
+
+        size_t written = TransferHandler::write(address + done, buffer.data(), n);
+        done += written;
+
+        if (written != (size_t)n) break;
+    }
+
+    close(fd);
+
+    TransferHandler::release(address, done);
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+    if (done < length) {
+        cerr << "** [loadmem] error, only " << done << " of " << length << " bytes loaded from '" << path << "'" << '\n';
+
+        return false;
+    }
+
+    TransferHandler::report("loaded from '" + path + "'", length, elapsed.count());
+
+    return true;
+}
+
+// bytes are hex digits in pairs, spaces and a leading 0x are allowed
+bool TransferHandler::patch(pid_t pid, unsigned long address, string bytes)
+{
+    if (bytes.compare(0, 2, "0x") == 0) {
+        bytes = bytes.substr(2);
+    }
+
+    string digits;
+
+    for (auto c : bytes) {
+        if (isspace((unsigned char)c)) continue;
+
+        if (!isxdigit((unsigned char)c)) {
+            cerr << "** [patch] error, '" << c << "' is not a hex digit" << '\n';
+
+            return false;
+        }
+
+        digits.push_back(c);
+    }
+
+    if (digits.empty() || digits.size() % 2 != 0) {
+        cerr << "** [patch] error, bytes need two hex digits each" << '\n';
+
+        return false;
+    }
+
+    vector<unsigned char> buffer(digits.size() / 2);
+
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = stoul(digits.substr(i * 2, 2), NULL, 16);
+    }
+
+    if (!TransferHandler::mapped(pid, address, buffer.size())) {
+        cerr << "** [patch] error, the range is not mapped" << '\n';
+
+        return false;
+    }
+
+    size_t length = buffer.size();
+    size_t written = TransferHandler::write(address, buffer.data(), length);
+
+    TransferHandler::release(address, written);
+
+    if (written != length) {
+        cerr << "** [patch] error, only " << written << " of " << length << " bytes written" << '\n';
+
+        return false;
+    }
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << "** patched " << dec << length << (length == 1 ? " byte" : " bytes") << " at 0x" << hex << address << '\n';
+
+    cout.copyfmt(state);
+
+    return true;
+}
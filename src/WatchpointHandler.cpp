@@ -0,0 +1,265 @@
+#include "WatchpointHandler.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include "MemoryHandler.h"
+#include "ThreadHandler.h"
+
+using namespace std;
+
+pid_t WatchpointHandler::m_pid = -1;
+int WatchpointHandler::m_next_id = 0;
+unsigned long WatchpointHandler::m_dr7 = 0;
+unsigned long WatchpointHandler::m_generation = 0;
+unordered_map<pid_t, unsigned long> WatchpointHandler::m_synced;
+vector<Watchpoint> WatchpointHandler::m_watchpoints;
+
+WatchpointHandler::WatchpointHandler()
+{
+}
+
+WatchpointHandler::~WatchpointHandler()
+{
+}
+
+bool WatchpointHandler::poke(pid_t tid, int index, unsigned long value)
+{
+    return ptrace(PTRACE_POKEUSER, tid, offsetof(struct user, u_debugreg) + index * sizeof(unsigned long), value) == 0;
+}
+
+// debug registers are per thread and a new thread starts without any, the selected thread already has the new ones
+// every other stopped thread gets them now, a running one at its next stop
+void WatchpointHandler::publish()
+{
+    WatchpointHandler::m_generation += 1;
+    WatchpointHandler::m_synced[WatchpointHandler::m_pid] = WatchpointHandler::m_generation;
+
+    for (auto thread : ThreadHandler::list()) {
+        if (thread->state == THREAD_STATE::THREAD_STOPPED) {
+            WatchpointHandler::sync(thread->tid);
+        }
+    }
+}
+
+unsigned long WatchpointHandler::load(unsigned long address, unsigned char length)
+{
+    unsigned long value = 0;
+    MemoryHandler::read(address, &value, length);
+
+    return value;
+}
+
+void WatchpointHandler::attach(pid_t pid)
+{
+    WatchpointHandler::detach();
+
+    WatchpointHandler::m_pid = pid;
+}
+
+// the debug registers are only reset if the tracee is still there, a terminated child takes them with it
+void WatchpointHandler::detach()
+{
+    if (WatchpointHandler::m_pid != -1 && WatchpointHandler::m_dr7 != 0) {
+        WatchpointHandler::poke(WatchpointHandler::m_pid, 7, 0);
+    }
+
+    for (auto& [tid, generation] : WatchpointHandler::m_synced) {
+        if (tid != WatchpointHandler::m_pid && generation != 0) {
+            WatchpointHandler::poke(tid, 7, 0);
+        }
+    }
+
+    WatchpointHandler::m_pid = -1;
+    WatchpointHandler::m_dr7 = 0;
+    WatchpointHandler::m_generation = 0;
+    WatchpointHandler::m_synced.clear();
+    WatchpointHandler::m_watchpoints.clear();
+}
+
+// DR6 is read from the thread that reported the stop
+void WatchpointHandler::select(pid_t tid)
+{
+    WatchpointHandler::m_pid = tid;
+}
+
+// bring the debug registers of a stopped thread up to date, nothing to do if it has the latest ones
+void WatchpointHandler::sync(pid_t tid)
+{
+    auto it = WatchpointHandler::m_synced.find(tid);
+
+    if (it == WatchpointHandler::m_synced.end() ? WatchpointHandler::m_dr7 == 0 : it->second == WatchpointHandler::m_generation) return;
+
+    for (auto& watchpoint : WatchpointHandler::m_watchpoints) {
+        if (watchpoint.slot != -1) {
+            WatchpointHandler::poke(tid, watchpoint.slot, watchpoint.address);
+        }
+    }
+
+    if (WatchpointHandler::poke(tid, 7, WatchpointHandler::m_dr7)) {
+        WatchpointHandler::m_synced[tid] = WatchpointHandler::m_generation;
+    }
+}
+
+// a debug register needs length 1, 2, 4 or 8 and an address aligned to it, execute breakpoints always have length 1
+// without a usable register a write watchpoint may fall back to software when fallback is set, returns the id or -1
+int WatchpointHandler::add(unsigned long address, unsigned char length, WATCH_TYPE type, bool fallback)
+{
+    if (length != 1 && length != 2 && length != 4 && length != 8) return -1;
+
+    int slot = -1;
+
+    if (address % length == 0 && (type != WATCH_TYPE::WATCH_EXECUTE || length == 1)) {
+        for (int i = 0; i < WatchpointHandler::SLOTS; i++) {
+            if ((WatchpointHandler::m_dr7 & (1UL << (i * 2))) == 0) {
+                slot = i;
+
+                break;
+            }
+        }
+    }
+
+    if (slot != -1) {
+        // R/W bits: 00 execute, 01 write, 11 read or write; LEN bits: 00 1 byte, 01 2, 11 4, 10 8
+        unsigned long rw = (type == WATCH_TYPE::WATCH_EXECUTE ? 0 : type == WATCH_TYPE::WATCH_WRITE ? 1 : 3);
+        unsigned long len = (length == 1 ? 0 : length == 2 ? 1 : length == 4 ? 3 : 2);
+        unsigned long dr7 = WatchpointHandler::m_dr7;
+
+        dr7 &= ~(0xfUL << (16 + slot * 4));
+        dr7 |= ((len << 2) | rw) << (16 + slot * 4);
+        dr7 |= 1UL << (slot * 2);
+
+        if (!WatchpointHandler::poke(WatchpointHandler::m_pid, slot, address) || !WatchpointHandler::poke(WatchpointHandler::m_pid, 7, dr7)) return -1;
+
+        WatchpointHandler::m_dr7 = dr7;
+    }
+    else if (!fallback || type != WATCH_TYPE::WATCH_WRITE) {
+        return -1;
+    }
+
+    unsigned long value = (type == WATCH_TYPE::WATCH_EXECUTE ? 0 : WatchpointHandler::load(address, length));
+
+    WatchpointHandler::m_watchpoints.push_back(
+        Watchpoint {
+            .id = WatchpointHandler::m_next_id,
+            .address = address,
+            .length = length,
+            .type = type,
+            .slot = slot,
+            .value = value,
+            .previous = value,
+            .hits = 0
+        }
+    );
+
+    if (slot != -1) {
+        WatchpointHandler::publish();
+    }
+
+    return WatchpointHandler::m_next_id++;
+}
+
+bool WatchpointHandler::remove(int id)
+{
+    for (auto it = WatchpointHandler::m_watchpoints.begin(); it != WatchpointHandler::m_watchpoints.end(); it++) {
+        if (it->id != id) continue;
+
+        if (it->slot != -1) {
+            unsigned long dr7 = WatchpointHandler::m_dr7 & ~(1UL << (it->slot * 2)) & ~(0xfUL << (16 + it->slot * 4));
+
+            WatchpointHandler::poke(WatchpointHandler::m_pid, 7, dr7);
+            WatchpointHandler::m_dr7 = dr7;
+        }
+
+        bool hardware = (it->slot != -1);
+
+        WatchpointHandler::m_watchpoints.erase(it);
+
+        if (hardware) {
+            WatchpointHandler::publish();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+Watchpoint const* WatchpointHandler::get(int id)
+{
+    for (auto& watchpoint : WatchpointHandler::m_watchpoints) {
+        if (watchpoint.id == id) return &watchpoint;
+    }
+
+    return NULL;
+}
+
+vector<Watchpoint> const& WatchpointHandler::list()
+{
+    return WatchpointHandler::m_watchpoints;
+}
+
+// any debug register in use, only then is DR6 worth reading on a stop
+bool WatchpointHandler::armed()
+{
+    return WatchpointHandler::m_dr7 != 0;
+}
+
+bool WatchpointHandler::software()
+{
+    for (auto& watchpoint : WatchpointHandler::m_watchpoints) {
+        if (watchpoint.slot == -1) return true;
+    }
+
+    return false;
+}
+
+// the watchpoint whose debug register fired according to DR6, NULL if none did, DR6 is cleared for the next stop
+Watchpoint* WatchpointHandler::hit()
+{
+    if (!WatchpointHandler::armed()) return NULL;
+
+    errno = 0;
+    unsigned long dr6 = ptrace(PTRACE_PEEKUSER, WatchpointHandler::m_pid, offsetof(struct user, u_debugreg) + 6 * sizeof(unsigned long), 0);
+
+    if (errno != 0 || (dr6 & 0xf) == 0) return NULL;
+
+    WatchpointHandler::poke(WatchpointHandler::m_pid, 6, 0);
+
+    for (auto& watchpoint : WatchpointHandler::m_watchpoints) {
+        if (watchpoint.slot == -1 || (dr6 & (1UL << watchpoint.slot)) == 0) continue;
+
+        watchpoint.hits += 1;
+
+        if (watchpoint.type != WATCH_TYPE::WATCH_EXECUTE) {
+            watchpoint.previous = watchpoint.value;
+            watchpoint.value = WatchpointHandler::load(watchpoint.address, watchpoint.length);
+        }
+
+        return &watchpoint;
+    }
+
+    return NULL;
+}
+
+// the first software watchpoint whose memory differs from the last seen value
+Watchpoint* WatchpointHandler::changed()
+{
+    for (auto& watchpoint : WatchpointHandler::m_watchpoints) {
+        if (watchpoint.slot != -1) continue;
+
+        unsigned long value = WatchpointHandler::load(watchpoint.address, watchpoint.length);
+
+        if (value != watchpoint.value) {
+            watchpoint.hits += 1;
+            watchpoint.previous = watchpoint.value;
+            watchpoint.value = value;
+
+            return &watchpoint;
+        }
+    }
+
+    return NULL;
+}
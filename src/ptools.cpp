@@ -4,8 +4,16 @@
 #include <sstream>
 #include <vector>
 #include <iomanip>
+#include <cerrno>
+#include <csignal>
 #include <libgen.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "MemoryHandler.h"
+#include "RegisterHandler.h"
 
 using namespace std;
 
@@ -14,11 +22,23 @@ map<string, string> parse(int argc, char* argv[])
     int opt = 0;
     map<string, string> args;
 
-    while ((opt = getopt(argc, argv, "s:")) != -1) {
+    while ((opt = getopt(argc, argv, "s:b:p:y:")) != -1) {
         switch (opt) {
             case 's':
                 args["script"] = optarg;
 
+                break;
+            case 'b':
+                args["budget"] = optarg;
+
+                break;
+            case 'p':
+                args["pid"] = optarg;
+
+                break;
+            case 'y':
+                args["syscalls"] = optarg;
+
                 break;
             default:
                 break;
@@ -60,19 +80,19 @@ vector<string> prompt(string message, istream& in)
     return command;
 }
 
-void dump_code(unsigned long addr, unsigned long code[], int length)
+void dump_code(unsigned long addr, unsigned char const code[], int length)
 {
     printf("%12lx:", addr);
 
     for (auto i = 0; i < min(16, length); i++) {
-        printf(" %02x", ((unsigned char*)code)[i]);
+        printf(" %02x", code[i]);
     }
 
     printf("  ");
 
     printf("|");
     for (auto i = 0; i < min(16, length); i++) {
-        char c = ((char*)code)[i];
+        char c = code[i];
 
         printf("%c", isprint(c) ? c : '.');
     }
@@ -104,12 +124,12 @@ int load_maps(pid_t pid, map<range_t, map_entry_t>& loaded)
             args.push_back(token);
         }
 
-        if (args.size() < 6) continue;
+        if (args.size() < 5) continue;
 
         auto it = args[0].find('-');
         if (it != string::npos) {
-            m.range.begin = strtol(args[0].substr(0, it).c_str(), NULL, 16);
-            m.range.end = strtol(args[0].substr(it + 1).c_str(), NULL, 16);
+            m.range.begin = strtoul(args[0].substr(0, it).c_str(), NULL, 16);
+            m.range.end = strtoul(args[0].substr(it + 1).c_str(), NULL, 16);
         }
 
         m.permission = 0;
@@ -121,7 +141,7 @@ int load_maps(pid_t pid, map<range_t, map_entry_t>& loaded)
 		m.offset = stol(args[2], NULL, 16);
 
         m.node = args[4];
-        m.name = args[5];
+        m.name = (args.size() >= 6 ? args[5] : "");
 
         loaded[m.range] = m;
     }
@@ -131,6 +151,94 @@ int load_maps(pid_t pid, map<range_t, map_entry_t>& loaded)
     return loaded.size();
 }
 
+// run one system call inside the stopped tracee by placing a syscall instruction at rip and single-stepping it
+// registers and the overwritten bytes are put back afterwards, returns rax (-errno on failure)
+long inject_syscall(pid_t pid, long number, vector<unsigned long> const& args)
+{
+    struct user_regs_struct saved = RegisterHandler::get();
+
+    unsigned char code[2];
+    unsigned char syscall_code[2] = { 0x0f, 0x05 };
+
+    if (MemoryHandler::read(saved.rip, code, 2) != 2 || MemoryHandler::write(saved.rip, syscall_code, 2) != 2) return -EFAULT;
+
+    struct user_regs_struct& regs = RegisterHandler::modify();
+    unsigned long long* arguments[] = { &regs.rdi, &regs.rsi, &regs.rdx, &regs.r10, &regs.r8, &regs.r9 };
+
+    regs.rax = number;
+    regs.orig_rax = -1;
+
+    for (size_t i = 0; i < args.size() && i < 6; i++) {
+        *arguments[i] = args[i];
+    }
+
+    RegisterHandler::flush();
+
+    int status = 0;
+
+    // event stops inside the call, such as the fork event of an injected fork, are stepped past as well
+    do {
+        ptrace(PTRACE_SINGLESTEP, pid, 0, 0);
+        waitpid(pid, &status, __WALL);
+    } while (WIFSTOPPED(status) && (status >> 16) != 0);
+
+    RegisterHandler::invalidate();
+    MemoryHandler::invalidate();
+
+    if (!WIFSTOPPED(status)) return -ESRCH;
+
+    // anything but the trap right after the syscall means it never ran
+    long result = -EINTR;
+
+    if (WSTOPSIG(status) == SIGTRAP && RegisterHandler::get().rip == saved.rip + 2) {
+        result = RegisterHandler::get().rax;
+    }
+
+    MemoryHandler::write(saved.rip, code, 2);
+    RegisterHandler::modify() = saved;
+
+    return result;
+}
+
+vector<pid_t> list_threads(pid_t pid)
+{
+    vector<pid_t> tids;
+
+    string path = "/proc/" + to_string(pid) + "/task";
+    DIR* directory = opendir(path.c_str());
+
+    if (directory == NULL) return tids;
+
+    struct dirent* entry = NULL;
+
+    while ((entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        tids.push_back(atoi(entry->d_name));
+    }
+
+    closedir(directory);
+
+    return tids;
+}
+
+// the thread group (process id) a thread belongs to, -1 if it is gone
+pid_t thread_group(pid_t tid)
+{
+    fstream file;
+    file.open("/proc/" + to_string(tid) + "/status", ios::in);
+
+    if (!file.is_open()) return -1;
+
+    string buffer;
+
+    while (getline(file, buffer)) {
+        if (buffer.compare(0, 5, "Tgid:") == 0) return atoi(buffer.c_str() + 5);
+    }
+
+    return -1;
+}
+
 bool operator<(range_t r1, range_t r2)
 {
     return (r1.begin < r2.begin && r1.end < r2.end);
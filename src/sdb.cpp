@@ -1,4 +1,9 @@
 #include <iostream>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
 #include <map>
 #include <string>
 #include <sstream>
@@ -8,6 +13,9 @@
 #include <unistd.h>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
 #include <elf.h>
 #include <sys/user.h>
 #include <capstone/capstone.h>
@@ -16,14 +24,156 @@
 #include "ptools.h"
 #include "CommandHandler.h"
 #include "BreakpointHandler.h"
+#include "MemoryHandler.h"
+#include "RegisterHandler.h"
+#include "DisassembleHandler.h"
+#include "ElfHandler.h"
+#include "SymbolHandler.h"
+#include "TrampolineHandler.h"
+#include "ExpressionHandler.h"
+#include "WatchpointHandler.h"
+#include "TraceHandler.h"
+#include "ProfileHandler.h"
+#include "ThreadHandler.h"
+#include "SyscallHandler.h"
+#include "SearchHandler.h"
+#include "SnapshotHandler.h"
+#include "CoreHandler.h"
+#include "TransferHandler.h"
+#include "CheckpointHandler.h"
 
 using namespace std;
 
 static STATUS current_status = STATUS::NONE;
 static pid_t child = -1;
 static int wait_status = -1;
-map<unsigned long, cs_insn> instructions;
+static enum __ptrace_request last_request = PTRACE_CONT;
+static constexpr long TRACE_OPTIONS = PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEVFORKDONE | PTRACE_O_TRACEEXEC | PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD;
+static vector<pid_t> forked;
+static bool attached = false;
+static bool filtered = false;
+
+// where next, finish and until are heading, in its frame the address stops there whatever a user breakpoint on it says
+static struct {
+    bool active;
+    bool reached;
+    bool borrowed;
+    unsigned long address;
+    vector<Operation> program;
+} run_target = { false, false, false, 0, {} };
 range_t text_address;
+range_t code_address;
+
+// the whole of text as a number, stoul throws on a bad argument and takes the tracee down with sdb, strtoul alone stops early
+bool to_number(string const& text, unsigned long& value, int base = 0)
+{
+    char* end = NULL;
+
+    if (text.empty() || text[0] == '-' || isspace((unsigned char)text[0])) return false;
+
+    errno = 0;
+    value = strtoul(text.c_str(), &end, base);
+
+    return errno == 0 && *end == '\0';
+}
+
+// break point, watch point, checkpoint and snapshot ids, pids and tids
+bool to_number(string const& text, int& value)
+{
+    unsigned long number = 0;
+
+    if (!to_number(text, number, 10) || number > INT_MAX) return false;
+
+    value = number;
+
+    return true;
+}
+
+// how far the executable of pid was moved from its link-time addresses, from where its first loadable segment is mapped
+bool load_bias(pid_t pid, unsigned long& bias)
+{
+    char name[PATH_MAX] = {};
+    map<range_t, map_entry_t> vmmap;
+
+    if (readlink(("/proc/" + to_string(pid) + "/exe").c_str(), name, sizeof(name) - 1) < 0 || load_maps(pid, vmmap) < 0) return false;
+
+    unsigned long page = sysconf(_SC_PAGESIZE);
+
+    for (auto p_header : ElfHandler::segments()) {
+        if (p_header->p_type != PT_LOAD) continue;
+
+        for (auto& [range, entry] : vmmap) {
+            if (entry.name != name || (unsigned long)entry.offset != (p_header->p_offset & ~(page - 1))) continue;
+
+            bias = range.begin - (p_header->p_vaddr & ~(page - 1));
+
+            return true;
+        }
+
+        break;
+    }
+
+    return false;
+}
+
+// the executable is parsed before the tracee is touched, an attached process does not wait on it
+// a position-independent one is relocated to where it is mapped in pid, which has to be past execve already
+bool load_executable(string path, pid_t pid)
+{
+    if (!ElfHandler::load(path)) return false;
+
+    unsigned long bias = 0;
+
+    if (ElfHandler::header()->e_type == ET_DYN) {
+        if (!load_bias(pid, bias)) {
+            cerr << "** [elf] warning, '" << path << "' is not mapped in pid " << pid << ", symbols are not relocated" << '\n';
+        }
+
+        ElfHandler::relocate(bias);
+    }
+
+    SymbolHandler::load();
+
+    Elf64_Ehdr const* e_header = ElfHandler::header();
+    Section const* text = ElfHandler::section(".text");
+
+    if (text != NULL) {
+        text_address.begin = text->header->sh_addr;
+        text_address.end = text->header->sh_addr + text->header->sh_size;
+    }
+    else {
+        text_address.begin = text_address.end = e_header->e_entry;
+    }
+
+    // decode the whole executable segment so .init, .plt and .fini disassemble as well as .text
+    code_address = text_address;
+    Elf64_Phdr const* p_header = ElfHandler::segment(text_address.begin);
+
+    if (p_header != NULL && (p_header->p_flags & PF_X)) {
+        code_address.begin = p_header->p_vaddr;
+        code_address.end = p_header->p_vaddr + p_header->p_filesz;
+    }
+
+    if (!DisassembleHandler::load(ElfHandler::data(code_address.begin, code_address.end - code_address.begin), code_address.begin + bias, code_address.end + bias)) {
+        cerr << "** [capstone] error, disassemble fail" << '\n';
+    }
+
+    text_address.begin += bias;
+    text_address.end += bias;
+    code_address.begin += bias;
+    code_address.end += bias;
+
+    return true;
+}
+
+void attach_handlers(pid_t pid)
+{
+    MemoryHandler::attach(pid);
+    RegisterHandler::attach(pid);
+    TrampolineHandler::attach(pid, code_address.begin);
+    WatchpointHandler::attach(pid);
+    SnapshotHandler::attach(pid);
+}
 
 void load_program(map<string, string>& args)
 {
@@ -45,667 +195,2857 @@ void load_program(map<string, string>& args)
         }
         arguments.push_back(NULL);
 
-        if (ptrace(PTRACE_TRACEME, 0, 0, 0) < 0) {
-            cerr << "** [ptrace] error, traceme" << '\n';
+        // wait for the parent to seize us, PTRACE_SEIZE (unlike PTRACE_TRACEME) allows PTRACE_INTERRUPT later on
+        raise(SIGSTOP);
 
-            exit(EXIT_FAILURE);
-        }
+        // the filter outlives execvp and is inherited by every thread and child of the program
+        SyscallHandler::install();
 
         execvp(args["program"].c_str(), arguments.data());
 
         exit(EXIT_FAILURE);
     }
     else {
-        waitpid(child, &wait_status, 0);
-        ptrace(PTRACE_SETOPTIONS, child, 0, PTRACE_O_EXITKILL);
-
-        FILE* file = fopen(args["program"].c_str(), "rb");
+        waitpid(child, &wait_status, WUNTRACED);
 
-        if (!file) {
-            cerr << "** [load] error, program not found" << '\n';
+        if (ptrace(PTRACE_SEIZE, child, 0, PTRACE_O_EXITKILL | TRACE_OPTIONS) < 0) {
+            cerr << "** [ptrace] error, seize" << '\n';
 
-            return;
+            exit(EXIT_FAILURE);
         }
 
-        int fd = fileno(file);
+        filtered = !SyscallHandler::selected().empty();
+        SyscallHandler::clear();
 
-        Elf64_Ehdr e_header;
-        fread(&e_header, 1, sizeof(e_header), file);
+        kill(child, SIGCONT);
 
-        vector<Elf64_Shdr> s_headers(e_header.e_shnum);
-        lseek(fd, e_header.e_shoff, SEEK_SET);
-        for (size_t i = 0; i < s_headers.size(); i++) {
-            read(fd, &(s_headers[i]), e_header.e_shentsize);
+        // pass the group-stop and SIGCONT stops until the exec event, a seized tracee gets no SIGTRAP after execve
+        while (waitpid(child, &wait_status, 0) == child && WIFSTOPPED(wait_status) && (wait_status >> 16) != PTRACE_EVENT_EXEC) {
+            ptrace(PTRACE_CONT, child, 0, 0);
         }
 
-        vector<char> sh_str(s_headers[e_header.e_shstrndx].sh_size);
-        lseek(fd, s_headers[e_header.e_shstrndx].sh_offset, SEEK_SET);
-        read(fd, sh_str.data(), s_headers[e_header.e_shstrndx].sh_size);
+        if (!load_executable(args["program"], child)) return;
 
-        vector<char> text_buffer;
-        for (auto s_header : s_headers) {
-            string section_name = sh_str.data() + s_header.sh_name;
+        attach_handlers(child);
 
-            if (section_name == ".text") {
-                text_address.begin = e_header.e_entry;
-                text_address.end = e_header.e_entry + s_header.sh_size;
+        ThreadHandler::clear();
+        ThreadHandler::add(child, THREAD_STATE::THREAD_STOPPED);
+        ThreadHandler::select(child);
+
+        ios state(nullptr);
+        state.copyfmt(cout);
 
-                text_buffer.resize(s_header.sh_size);
+        current_status = STATUS::LOADED;
+        cout << "** program '" << args["program"] << "' loaded. entry point 0x" << hex << ElfHandler::header()->e_entry + ElfHandler::bias() << '\n';
 
-                lseek(fd, s_header.sh_offset, SEEK_SET);
-                read(fd, text_buffer.data(), s_header.sh_size);
+        cout.copyfmt(state);
+    }
+}
 
-                break;
-            }
-        }
+// registers and displaced-step injections follow the selected thread, memory is shared by all of them
+void select_thread(pid_t tid)
+{
+    RegisterHandler::flush();
+    RegisterHandler::attach(tid);
+    TrampolineHandler::select(tid);
+    WatchpointHandler::select(tid);
+    ThreadHandler::select(tid);
+}
 
-        fclose(file);
+// a forked child gets a copy of our int3s, they are taken out before it runs untraced
+// after vfork it shares our memory, so the breakpoints stay out until the parent reports PTRACE_EVENT_VFORK_DONE
+void release_fork(pid_t pid, bool shared)
+{
+    MemoryHandler::invalidate();
 
-        csh handle;
-        cs_insn* insn;
+    if (shared) {
+        BreakpointHandler::arm(false);
+    }
+    else {
+        MemoryHandler::attach(pid);
+        BreakpointHandler::arm(false);
+        MemoryHandler::attach(child);
+    }
 
-        if (cs_open(CS_ARCH_X86, CS_MODE_64, &handle) != CS_ERR_OK) {
-            cerr << "** [capstone] error, cs_open fail" << '\n';
-        }
+    ptrace(PTRACE_DETACH, pid, 0, 0);
 
-        size_t count = cs_disasm(handle, (unsigned char*)text_buffer.data(), text_buffer.size(), e_header.e_entry, 0, &insn);
+    cout << "** detached from forked process " << dec << pid << '\n';
 
-        if (count > 0) {
-            for (size_t i = 0; i < count; i++) {
-                instructions[insn[i].address] = insn[i];
-            }
+    if (filtered) {
+        cout << "** the seccomp filter stays in process " << dec << pid << ", its traced system calls fail with ENOSYS" << '\n';
+    }
+}
 
-            cs_free(insn, count);
-        }
-        else {
-            cerr << "** [capstone] error, disassemble fail" << '\n';
-        }
+// the exec'ing thread takes over the pid of the process and every other thread is gone, so is every breakpoint
+void reload_program()
+{
+    BreakpointHandler::clear();
+    WatchpointHandler::detach();
+    TrampolineHandler::detach();
+    DisassembleHandler::unload();
+    SymbolHandler::unload();
+    ElfHandler::unload();
+
+    string exe = "/proc/" + to_string(child) + "/exe";
+
+    char name[PATH_MAX] = {};
+    if (readlink(exe.c_str(), name, sizeof(name) - 1) < 0 || !load_executable(exe, child)) {
+        cerr << "** [exec] error, cannot read the new executable" << '\n';
+    }
 
-        ios state(nullptr);
-        state.copyfmt(cout);
+    attach_handlers(child);
 
-        current_status = STATUS::LOADED;
-        cout << "** program '" << args["program"] << "' loaded. entry point 0x" << hex << e_header.e_entry << '\n';
+    ThreadHandler::clear();
+    ThreadHandler::add(child, THREAD_STATE::THREAD_STOPPED);
+    select_thread(child);
 
-        cout.copyfmt(state);
-    }
+    cout << "** process " << dec << child << " executed '" << name << "', break points removed" << '\n';
 }
 
-void restore_code()
+// everything known about a program that is gone
+void unload_program()
 {
-    struct user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, child, 0, &regs);
+    current_status = STATUS::NONE;
+
+    BreakpointHandler::clear();
+    MemoryHandler::detach();
+    DisassembleHandler::unload();
+    SymbolHandler::unload();
+    TrampolineHandler::detach();
+    WatchpointHandler::detach();
+    SnapshotHandler::detach();
+    CheckpointHandler::clear();
+    ElfHandler::unload();
+
+    attached = false;
+    filtered = false;
+    forked.clear();
+    ThreadHandler::clear();
+}
 
-    unsigned long code = ptrace(PTRACE_PEEKTEXT, child, regs.rip, 0);
+// every thread of a traced process reports its end to us, the leader only after all the others
+void kill_program()
+{
+    pid_t tid = -1;
+    int status = 0;
 
-    if ((code & 0xff) == 0xcc) {
-        code = ((code & 0xffffffffffffff00) | BreakpointHandler::get(BreakpointHandler::find(regs.rip)).code);
+    kill(child, SIGKILL);
 
-        if (ptrace(PTRACE_POKETEXT, child, regs.rip, code) != 0) {
-            cerr << "** [ptrace] error, restore code" << '\n';
-        }
-    }
+    while ((tid = waitpid(-1, &status, __WALL)) > 0 && (tid != child || WIFSTOPPED(status)));
 }
 
-void check_breakpoint()
+// thread, fork and exec events are handled here, true if the stop of tid has to be reported
+// a reported stop selects its thread and, in all-stop mode, stops every other thread
+bool dispatch(pid_t tid, int status)
 {
-    ios state(nullptr);
-    state.copyfmt(cout);
+    Thread* thread = ThreadHandler::get(tid);
+    pid_t current = ThreadHandler::current();
 
-    struct user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, child, 0, &regs);
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+        // the leader is reported last, once the whole process is gone
+        if (tid == child) {
+            wait_status = status;
 
-    unsigned long code = ptrace(PTRACE_PEEKTEXT, child, regs.rip - 1, 0);
+            return true;
+        }
 
-    if ((code & 0xff) == 0xcc) {
-        cout << "** breakpoint @ ";
+        ThreadHandler::remove(tid);
 
-        cs_insn instruction = instructions[regs.rip - 1];
-        cout << hex << setw(12) << setfill(' ') << right << (regs.rip - 1) << ":";
+        if (thread != NULL && tid == current) {
+            cout << "** thread " << dec << tid << " exited" << '\n';
 
-        for (auto i = 0; i < 16 && i < instruction.size; i++) {
-            cout << " " << hex << setw(2) << setfill('0') << (unsigned int)instruction.bytes[i];
+            select_thread(child);
         }
 
-        cout << '\t' << instruction.mnemonic << '\t' << instruction.op_str << '\n';
+        return false;
+    }
 
-        regs.rip -= 1;
-        regs.rdx = regs.rax;
+    if (thread == NULL) {
+        // the first stop of a forked process may come before the fork event of its parent
+        if (thread_group(tid) != child) {
+            forked.push_back(tid);
 
-        if (ptrace(PTRACE_SETREGS, child, 0, &regs) != 0) {
-            cerr << "** [ptrace] error, set regs";
+            return false;
         }
+
+        // just as a new thread may report before the clone event of its creator
+        ThreadHandler::add(tid, THREAD_STATE::THREAD_RUNNING);
+        WatchpointHandler::sync(tid);
+        ptrace(PTRACE_CONT, tid, 0, 0);
+
+        return false;
     }
 
-    cout.copyfmt(state);
-}
+    // a new thread starts without debug registers, one that ran through a watch or unwatch gets them now
+    WatchpointHandler::sync(tid);
 
-int main(int argc, char* argv[])
-{
-    map<string, string> args = parse(argc, argv);
-    load_program(args);
+    // an event stop of the thread being stepped goes on with the step, one inside a traced system call still waits for its exit
+    enum __ptrace_request request = (tid == current ? last_request : PTRACE_CONT);
 
-    fstream file;
-    if (args.find("script") != args.end()) {
-        file.open(args["script"]);
+    if (request == PTRACE_CONT && SyscallHandler::inflight(tid)) {
+        request = PTRACE_SYSCALL;
     }
 
-    while (true) {
-        vector<string> command;
+    unsigned long message = 0;
 
-        if (args.find("script") != args.end()) {
-            command = prompt("", file);
+    // a selected system call, the exit is caught with PTRACE_SYSCALL so unselected calls never stop
+    if (WIFSTOPPED(status) && (status >> 16) == PTRACE_EVENT_SECCOMP) {
+        struct user_regs_struct regs;
 
-            if (file.eof()) break;
-        }
-        else {
-            command = prompt("sdb> ", cin);
+        if (ptrace(PTRACE_GETREGS, tid, 0, &regs) == 0) {
+            SyscallHandler::enter(tid, regs);
         }
 
-        switch (CommandHandler::check(command, current_status)) {
-            case COMMAND_TYPE::EXIT:
-                return 0;
-            case COMMAND_TYPE::HELP:
-                cout << "- break {instruction-address}: add a break point" << '\n';
-                cout << "- cont: continue execution" << '\n';
-                cout << "- delete {break-point-id}: remove a break point" << '\n';
-                cout << "- disasm addr: disassemble instructions in a file or a memory region" << '\n';
-                cout << "- dump addr [length]: dump memory content" << '\n';
-                cout << "- exit: terminate the debugger" << '\n';
-                cout << "- get reg: get a single value from a register" << '\n';
-                cout << "- getregs: show registers" << '\n';
-                cout << "- help: show this message" << '\n';
-                cout << "- list: list break points" << '\n';
-                cout << "- load {path/to/a/program}: load a program" << '\n';
-                cout << "- run: run the program" << '\n';
-                cout << "- vmmap: show memory layout" << '\n';
-                cout << "- set reg val: get a single value to a register" << '\n';
-                cout << "- si: step into instruction" << '\n';
-                cout << "- start: start the program and stop at the first instruction" << '\n';
+        ptrace(PTRACE_SYSCALL, tid, 0, 0);
 
-                break;
-            case COMMAND_TYPE::LIST: {
-                ios state(nullptr);
-                state.copyfmt(cout);
-
-                if (BreakpointHandler::size() == 0) {
-                    cout << "no break point" << '\n';
-                }
-                else {
-                    for (int i = 0; i < BreakpointHandler::size(); i++) {
-                        cout << i << ": " << hex << BreakpointHandler::get(i).address << dec << '\n';
-                    }
-                }
+        return false;
+    }
 
-                cout.copyfmt(state);
+    if (WIFSTOPPED(status) && (status >> 16) == 0 && WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+        struct user_regs_struct regs;
 
-                break;
-            }
-            case COMMAND_TYPE::LOAD:
-                if (command.size() < 2) {
-                    cerr << "** [command] error, argument not enough" << '\n';
+        if (ptrace(PTRACE_GETREGS, tid, 0, &regs) == 0) {
+            SyscallHandler::leave(tid, regs);
+        }
 
-                    break;
-                }
+        request = (tid == current ? last_request : PTRACE_CONT);
 
-                args["program"] = command[1];
+        // a step over the syscall instruction ends at this stop, the kernel reports no other trap for it
+        if (request != PTRACE_SINGLESTEP) {
+            ptrace(request, tid, 0, 0);
 
-                args["program_arguments"] = "";
-                for (size_t i = 1; i < command.size(); i++) {
-                    args["program_arguments"] += command[i];
+            return false;
+        }
 
-                    if (i != command.size() - 1) {
-                        args["program_arguments"] += " ";
-                    }
-                }
+        status = W_STOPCODE(SIGTRAP);
+    }
 
-                load_program(args);
+    // an int3 taken out after this thread had already hit it, the thread goes back and runs the original instruction
+    if (WIFSTOPPED(status) && (status >> 16) == 0 && WSTOPSIG(status) == SIGTRAP) {
+        siginfo_t info;
+        struct user_regs_struct regs;
+        unsigned char code = 0;
 
-                break;
-            case COMMAND_TYPE::RUN: {
-                STATUS origin_status = current_status;
-                current_status = STATUS::RUNNING;
+        if (ptrace(PTRACE_GETSIGINFO, tid, 0, &info) == 0 && info.si_code == SI_KERNEL && ptrace(PTRACE_GETREGS, tid, 0, &regs) == 0 && BreakpointHandler::find(regs.rip - 1) == NULL && MemoryHandler::read(regs.rip - 1, &code, 1) == 1 && code != 0xcc) {
+            regs.rip -= 1;
 
-                if (origin_status == current_status) {
-                    cout << "** program" << args["program"] << " is already running." << '\n';
-                }
+            ptrace(PTRACE_SETREGS, tid, 0, &regs);
+            ptrace(request, tid, 0, 0);
 
-                restore_code();
+            return false;
+        }
+    }
 
-                ptrace(PTRACE_CONT, child, 0, 0);
+    switch (status >> 16) {
+        case PTRACE_EVENT_CLONE:
+            ptrace(PTRACE_GETEVENTMSG, tid, 0, &message);
 
-                if (origin_status != current_status) {
-                    cout << "** pid " << child << '\n';
-                }
+            if (ThreadHandler::get(message) == NULL) {
+                ThreadHandler::add(message, THREAD_STATE::THREAD_RUNNING);
+            }
 
-                waitpid(child, &wait_status, 0);
+            cout << "** new thread " << dec << message << '\n';
 
-                check_breakpoint();
+            ptrace(request, tid, 0, 0);
 
-                break;
-            }
-            case COMMAND_TYPE::START: {
-                current_status = STATUS::RUNNING;
+            return false;
+        case PTRACE_EVENT_FORK:
+        case PTRACE_EVENT_VFORK: {
+            ptrace(PTRACE_GETEVENTMSG, tid, 0, &message);
 
-                cout << "** pid " << child << '\n';
+            auto it = find(forked.begin(), forked.end(), (pid_t)message);
 
-                break;
+            if (it != forked.end()) {
+                forked.erase(it);
+            }
+            else {
+                int fork_status = 0;
+                waitpid(message, &fork_status, __WALL);
             }
-            case COMMAND_TYPE::BREAK: {
-                if (command.size() < 2) {
-                    cerr << "** [command] error, argument not enough" << '\n';
 
-                    break;
-                }
+            release_fork(message, (status >> 16) == PTRACE_EVENT_VFORK);
 
-                unsigned long target = stoul(command[1], NULL, 16);
-                unsigned long code = ptrace(PTRACE_PEEKTEXT, child, target, 0);
+            ptrace(request, tid, 0, 0);
 
-                if (BreakpointHandler::find(target) == -1) {
-                    BreakpointHandler::add(target, code & 0xff);
+            return false;
+        }
+        case PTRACE_EVENT_VFORK_DONE:
+            MemoryHandler::invalidate();
+            BreakpointHandler::arm(true);
 
-                    if (ptrace(PTRACE_POKETEXT, child, target, (code & 0xffffffffffffff00) | 0xcc) != 0) {
-                        cerr << "** [ptrace] error, set breakpoint" << '\n';
-                    }
-                }
-                else {
-                    cout << "breakpoint already exist" << '\n';
-                }
+            ptrace(request, tid, 0, 0);
 
-                break;
-            }
-            case COMMAND_TYPE::CONT:
-                restore_code();
+            return false;
+        case PTRACE_EVENT_EXEC:
+            reload_program();
 
-                ptrace(PTRACE_CONT, child, 0, 0);
-                waitpid(child, &wait_status, 0);
+            wait_status = status;
 
-                check_breakpoint();
+            return true;
+        case PTRACE_EVENT_STOP:
+            // an interrupt or the first stop of a new thread, the callers of the selected thread filter their own
+            if (WSTOPSIG(status) == SIGTRAP) {
+                if (tid == current) break;
 
-                break;
-            case COMMAND_TYPE::DELETE: {
-                if (command.size() < 2) {
-                    cerr << "** [command] error, argument not enough" << '\n';
+                ptrace(PTRACE_CONT, tid, 0, 0);
+                thread->state = THREAD_STATE::THREAD_RUNNING;
 
-                    break;
-                }
+                return false;
+            }
 
-                int index = stoi(command[1]);
+            break;
+        default:
+            break;
+    }
 
-                if (index < BreakpointHandler::size()) {
-                    unsigned long target = BreakpointHandler::get(index).address;
-                    unsigned long code = ptrace(PTRACE_PEEKTEXT, child, target, 0);
+    thread->state = THREAD_STATE::THREAD_STOPPED;
+    wait_status = status;
 
-                    code = ((code & 0xffffffffffffff00) | BreakpointHandler::get(index).code);
+    if (tid != current) {
+        select_thread(tid);
 
-                    if (ptrace(PTRACE_POKETEXT, child, target, code) != 0) {
-                        cerr << "** [ptrace] error, delete breakpoint" << '\n';
-                    }
+        cout << "** switched to thread " << dec << tid << '\n';
+    }
 
-                    BreakpointHandler::remove(index);
-                }
-                else {
-                    cout << "breakpoint not exist" << '\n';
-                }
+    if (!ThreadHandler::non_stop()) {
+        ThreadHandler::stop_others();
+    }
 
-                break;
-            }
-            case COMMAND_TYPE::DISASM: {
-                if (command.size() < 2) {
-                    cerr << "** [command] error, argument not enough" << '\n';
+    return true;
+}
 
-                    break;
-                }
+// wait until a stop has to be reported, stops already collected from other threads come first
+void wait_stop()
+{
+    while (true) {
+        Thread* thread = ThreadHandler::pending();
+        pid_t tid = -1;
+        int status = 0;
+
+        if (thread != NULL) {
+            thread->pending = false;
+            tid = thread->tid;
+            status = thread->status;
+        }
+        else if ((tid = waitpid(-1, &status, __WALL)) < 0) {
+            // nothing is traced any more
+            wait_status = 0;
 
-                ios state(nullptr);
-                state.copyfmt(cout);
+            return;
+        }
 
-                unsigned long target = stoul(command[1], NULL, 16);
+        if (dispatch(tid, status)) return;
+    }
+}
 
-                int count = 0;
-                for (auto instruction : instructions) {
-                    if (count >= 10) break;
+// stops dispatch() takes care of and resumes right away, a pending one of them does not hold back the others
+bool internal_stop(int status)
+{
+    if (!WIFSTOPPED(status)) return false;
+
+    switch (status >> 16) {
+        case PTRACE_EVENT_CLONE:
+        case PTRACE_EVENT_FORK:
+        case PTRACE_EVENT_VFORK:
+        case PTRACE_EVENT_VFORK_DONE:
+        case PTRACE_EVENT_SECCOMP:
+            return true;
+        case 0:
+            return WSTOPSIG(status) == (SIGTRAP | 0x80);
+        default:
+            return false;
+    }
+}
 
-                    if (instruction.first >= target) {
-                        cout << hex << setw(12) << setfill(' ') << right << instruction.first << ":";
+// pending register writes are flushed before the tracee runs, every cache is stale once it has
+void resume(enum __ptrace_request request)
+{
+    RegisterHandler::flush();
 
-                        for (auto i = 0; i < 16; i++) {
-                            cout << " ";
+    last_request = request;
 
-                            if (i < instruction.second.size) {
-                                cout << hex << setw(2) << setfill('0') << (unsigned int)instruction.second.bytes[i];
-                            }
-                            else {
-                                cout << "  ";
-                            }
-                        }
+    Thread* thread = ThreadHandler::get(ThreadHandler::current());
+    Thread* pending = ThreadHandler::pending();
 
-                        cout << instruction.second.mnemonic << '\t' << instruction.second.op_str << '\n';
+    // a stop that is not reported yet comes first, in all-stop mode nothing runs until it is
+    if (pending == NULL || (pending != thread && (ThreadHandler::non_stop() || request != PTRACE_CONT || internal_stop(pending->status)))) {
+        if (!ThreadHandler::non_stop() && request == PTRACE_CONT) {
+            ThreadHandler::resume_others();
+        }
 
-                        count += 1;
-                    }
-                }
+        // the selected thread may be inside a traced system call too, its exit has to stop
+        enum __ptrace_request current = request;
 
-                cout.copyfmt(state);
+        if (current == PTRACE_CONT && SyscallHandler::inflight(ThreadHandler::current())) {
+            current = PTRACE_SYSCALL;
+        }
 
-                break;
-            }
-            case COMMAND_TYPE::DUMP: {
-                if (command.size() < 2) {
-                    cerr << "** [command] error, argument not enough" << '\n';
+        ptrace(current, ThreadHandler::current(), 0, 0);
 
-                    break;
-                }
+        if (thread != NULL) {
+            thread->state = THREAD_STATE::THREAD_RUNNING;
+        }
+    }
 
-                ios state(nullptr);
-                state.copyfmt(cout);
+    RegisterHandler::invalidate();
+    MemoryHandler::invalidate();
+}
 
-                unsigned long target = stoul(command[1], NULL, 16);
+// a PTRACE_INTERRUPT that raced with another stop is delivered on the next resume and carries nothing to report
+bool stray_interrupt()
+{
+    return WIFSTOPPED(wait_status) && (wait_status >> 16) == PTRACE_EVENT_STOP && WSTOPSIG(wait_status) == SIGTRAP;
+}
 
-                if (target < text_address.begin || target >= text_address.end) break;
+// resume the tracee and wait for the next stop, an armed breakpoint at rip is passed without taking the int3 out
+// returns false if nothing ran, which only happens when single-stepping an emulated call
+bool run(enum __ptrace_request request)
+{
+    unsigned long address = RegisterHandler::get().rip;
+    Breakpoint const* breakpoint = BreakpointHandler::find(address);
 
-                int length = 80;
-                if (command.size() >= 3) {
-                    length = stoi(command[2]);
-                }
+    if (breakpoint != NULL && breakpoint->enabled) {
+        unsigned char code = breakpoint->code;
 
-                for (auto i = 0; i < (int)length / 16; i++) {
-                    unsigned long code[2];
+        switch (TrampolineHandler::displace(address, code)) {
+            case DISPLACE_TYPE::DISPLACED:
+                break;
+            case DISPLACE_TYPE::EMULATED:
+                if (request == PTRACE_SINGLESTEP) return false;
 
-                    code[0] = ptrace(PTRACE_PEEKTEXT, child, target, 0);
-                    code[1] = ptrace(PTRACE_PEEKTEXT, child, target + 8, 0);
+                break;
+            default: {
+                unsigned char int3 = 0xcc;
 
-                    dump_code(target, code);
-                    target += 16;
+                if (MemoryHandler::write(address, &code, 1) != 1) {
+                    cerr << "** [ptrace] error, restore code" << '\n';
                 }
 
-                if (length % 16 != 0) {
-                    unsigned long code[2];
+                do {
+                    resume(PTRACE_SINGLESTEP);
+                    wait_stop();
+                } while (stray_interrupt());
 
-                    code[0] = ptrace(PTRACE_PEEKTEXT, child, target, 0);
-                    code[1] = ptrace(PTRACE_PEEKTEXT, child, target + 8, 0);
+                if (!WIFSTOPPED(wait_status)) return true;
 
-                    dump_code(target, code, length % 16);
-                    target += (length % 16);
+                if (BreakpointHandler::find(address) != NULL) {
+                    MemoryHandler::write(address, &int3, 1);
                 }
 
-                cout.copyfmt(state);
+                if (request == PTRACE_SINGLESTEP || WSTOPSIG(wait_status) != SIGTRAP) return true;
 
                 break;
             }
-            case COMMAND_TYPE::GET: {
-                if (command.size() < 2) {
-                    cerr << "** [command] error, argument not enough" << '\n';
+        }
+    }
 
-                    break;
-                }
+    do {
+        resume(request);
+        wait_stop();
+    } while (stray_interrupt());
 
-                ios state(nullptr);
-                state.copyfmt(cout);
+    return true;
+}
 
-                struct user_regs_struct regs;
-                ptrace(PTRACE_GETREGS, child, 0, &regs);
+// "** title @ address <symbol>: bytes mnemonic operands"
+void print_location(string title, unsigned long address)
+{
+    ios state(nullptr);
+    state.copyfmt(cout);
 
-                unsigned long long* target_reg = NULL;
+    cout << "** " << title << " @ ";
+    cout << hex << setw(12) << setfill(' ') << right << address;
 
-                if (command[1] == "rax") {
-                    target_reg = &(regs.rax);
-                }
-                else if (command[1] == "rbx") {
-                    target_reg = &(regs.rbx);
-                }
-                else if (command[1] == "rcx") {
-                    target_reg = &(regs.rcx);
-                }
-                else if (command[1] == "rdx") {
-                    target_reg = &(regs.rdx);
-                }
-                else if (command[1] == "r8") {
-                    target_reg = &(regs.r8);
-                }
-                else if (command[1] == "r9") {
-                    target_reg = &(regs.r9);
-                }
-                else if (command[1] == "r10") {
-                    target_reg = &(regs.r10);
-                }
-                else if (command[1] == "r11") {
-                    target_reg = &(regs.r11);
-                }
-                else if (command[1] == "r12") {
-                    target_reg = &(regs.r12);
-                }
-                else if (command[1] == "r13") {
-                    target_reg = &(regs.r13);
-                }
-                else if (command[1] == "r14") {
-                    target_reg = &(regs.r14);
-                }
-                else if (command[1] == "r15") {
-                    target_reg = &(regs.r15);
-                }
-                else if (command[1] == "rdi") {
-                    target_reg = &(regs.rdi);
-                }
-                else if (command[1] == "rsi") {
-                    target_reg = &(regs.rsi);
-                }
-                else if (command[1] == "rbp") {
-                    target_reg = &(regs.rbp);
-                }
-                else if (command[1] == "rsp") {
-                    target_reg = &(regs.rsp);
-                }
-                else if (command[1] == "rip") {
-                    target_reg = &(regs.rip);
-                }
-                else if (command[1] == "flags") {
-                    target_reg = &(regs.eflags);
-                }
+    string symbol = SymbolHandler::symbolize(address);
+    if (!symbol.empty()) {
+        cout << " <" << symbol << ">";
+    }
 
-                if (target_reg == NULL) {
-                    cerr << "** [reg] error, wrong reg name" << '\n';
-                }
-                else {
-                    cout << command[1] << " = " << dec << (*target_reg) << hex << " (0x" << (*target_reg) << ")" << dec << '\n';
-                }
+    cout << ":";
 
-                cout.copyfmt(state);
+    vector<Instruction> instructions = DisassembleHandler::disassemble(address, 1);
 
-                break;
-            }
-            case COMMAND_TYPE::GETREGS: {
-                ios state(nullptr);
-                state.copyfmt(cout);
+    if (!instructions.empty()) {
+        Instruction const& instruction = instructions[0];
 
-                struct user_regs_struct regs;
-                ptrace(PTRACE_GETREGS, child, 0, &regs);
+        for (auto i = 0; i < 16 && i < instruction.size; i++) {
+            cout << " " << hex << setw(2) << setfill('0') << (unsigned int)instruction.bytes[i];
+        }
 
-                cout << hex;
+        cout << '\t' << instruction.mnemonic << '\t' << instruction.op_str;
+    }
 
-                cout << "RAX " << setw(18) << left << regs.rax;
-                cout << "RBX " << setw(18) << left << regs.rbx;
-                cout << "RCX " << setw(18) << left << regs.rcx;
-                cout << "RDX " << setw(18) << left << regs.rdx;
+    cout << '\n';
 
-                cout << '\n';
+    cout.copyfmt(state);
+}
 
-                cout << "R8  " << setw(18) << left << regs.r8;
-                cout << "R9  " << setw(18) << left << regs.r9;
-                cout << "R10 " << setw(18) << left << regs.r10;
-                cout << "R11 " << setw(18) << left << regs.r11;
+void print_watchpoint(Watchpoint const* watchpoint)
+{
+    if (watchpoint->type == WATCH_TYPE::WATCH_EXECUTE) {
+        print_location("hardware breakpoint w" + to_string(watchpoint->id), RegisterHandler::get().rip);
 
-                cout << '\n';
+        return;
+    }
 
-                cout << "R12 " << setw(18) << left << regs.r12;
-                cout << "R13 " << setw(18) << left << regs.r13;
-                cout << "R14 " << setw(18) << left << regs.r14;
-                cout << "R15 " << setw(18) << left << regs.r15;
+    ios state(nullptr);
+    state.copyfmt(cout);
 
-                cout << '\n';
+    cout << "** watchpoint w" << watchpoint->id << " @ " << hex << watchpoint->address;
 
-                cout << "RDI " << setw(18) << left << regs.rdi;
-                cout << "RSI " << setw(18) << left << regs.rsi;
-                cout << "RBP " << setw(18) << left << regs.rbp;
-                cout << "RSP " << setw(18) << left << regs.rsp;
+    string symbol = SymbolHandler::symbolize(watchpoint->address);
+    if (!symbol.empty()) {
+        cout << " <" << symbol << ">";
+    }
 
-                cout << '\n';
+    cout << ": 0x" << watchpoint->previous << " -> 0x" << watchpoint->value << '\n';
 
-                cout << "RIP " << setw(18) << left << regs.rip;
-                cout << "FLAGS " << setw(16) << setfill('0') << right << regs.eflags;
+    cout.copyfmt(state);
 
-                cout << '\n';
+    print_location("stopped", RegisterHandler::get().rip);
+}
 
-                cout << dec;
+// condition, tracepoint and ignore count of the breakpoint at rip, false if the tracee should just go on
+bool stop_at(Breakpoint* breakpoint)
+{
+    if (run_target.active && breakpoint->address == run_target.address) {
+        unsigned long result = 1;
 
-                cout.copyfmt(state);
+        if (run_target.program.empty() || (ExpressionHandler::evaluate(run_target.program, result) && result != 0)) {
+            run_target.reached = true;
 
-                break;
-            }
-            case COMMAND_TYPE::VMMAP: {
-                ios state(nullptr);
-                state.copyfmt(cout);
+            return true;
+        }
 
-                map<range_t, map_entry_t> vmmap;
+        // a disabled breakpoint is only armed for the target and an internal one only exists for it
+        if (breakpoint->internal || run_target.borrowed) return false;
+    }
 
-                load_maps(child, vmmap);
-                for (auto element : vmmap) {
-                    cout << element.second << '\n';
-                }
+    if (!breakpoint->program.empty()) {
+        unsigned long result = 0;
 
-                cout.copyfmt(state);
+        if (!ExpressionHandler::evaluate(breakpoint->program, result)) {
+            cerr << "** [expression] error, cannot evaluate '" << breakpoint->condition << "'" << '\n';
+        }
+        else if (result == 0) {
+            return false;
+        }
+    }
 
-                break;
-            }
-            case COMMAND_TYPE::SET: {
-                if (command.size() < 3) {
-                    cerr << "** [command] error, argument not enough" << '\n';
+    breakpoint->hits += 1;
 
-                    break;
-                }
+    // the caller of run_to() reports where it stopped
+    if (breakpoint->internal) return true;
 
-                struct user_regs_struct regs;
-                ptrace(PTRACE_GETREGS, child, 0, &regs);
+    if (breakpoint->trace) {
+        BreakpointHandler::record(*breakpoint);
 
-                unsigned long long* target_reg = NULL;
+        return false;
+    }
 
-                if (command[1] == "rax") {
-                    target_reg = &(regs.rax);
-                }
-                else if (command[1] == "rbx") {
-                    target_reg = &(regs.rbx);
+    if (breakpoint->ignore > 0) {
+        breakpoint->ignore -= 1;
+
+        return false;
+    }
+
+    print_location("breakpoint", breakpoint->address);
+
+    return true;
+}
+
+// false when the stop was a breakpoint whose condition does not hold, the caller resumes right away
+bool check_breakpoint()
+{
+    if (!WIFSTOPPED(wait_status)) return true;
+
+    TrampolineHandler::fixup();
+
+    if (WSTOPSIG(wait_status) != SIGTRAP) return true;
+
+    // debug register hits are told apart by DR6, which is only read while a register is in use
+    Watchpoint* watchpoint = WatchpointHandler::hit();
+
+    if (watchpoint != NULL) {
+        print_watchpoint(watchpoint);
+
+        return true;
+    }
+
+    struct user_regs_struct const& regs = RegisterHandler::get();
+
+    Breakpoint* breakpoint = BreakpointHandler::find(regs.rip - 1);
+
+    if (breakpoint == NULL || !breakpoint->enabled) return true;
+
+    // only an executed int3 (SI_KERNEL), not a single-step landing right after a breakpoint or a SIGTRAP the program raised itself
+    siginfo_t info;
+    if (ptrace(PTRACE_GETSIGINFO, ThreadHandler::current(), 0, &info) != 0 || info.si_code != SI_KERNEL) return true;
+
+    RegisterHandler::modify().rip -= 1;
+
+    return stop_at(breakpoint);
+}
+
+// run until something worth a prompt happens, software watchpoints force single-stepping with a memory compare per instruction
+void cont()
+{
+    if (!WatchpointHandler::software()) {
+        while (run(PTRACE_CONT) && !check_breakpoint());
+
+        return;
+    }
+
+    cout << "** software watchpoint active, single-stepping" << '\n';
+
+    while (true) {
+        run(PTRACE_SINGLESTEP);
+
+        if (!WIFSTOPPED(wait_status)) return;
+
+        TrampolineHandler::fixup();
+
+        if (WSTOPSIG(wait_status) != SIGTRAP) return;
+
+        Watchpoint* watchpoint = WatchpointHandler::hit();
+
+        if (watchpoint == NULL) {
+            watchpoint = WatchpointHandler::changed();
+        }
+
+        if (watchpoint != NULL) {
+            print_watchpoint(watchpoint);
+
+            return;
+        }
+
+        // stepping never executes an int3, a breakpoint is reached when rip lands on it
+        Breakpoint* breakpoint = BreakpointHandler::find(RegisterHandler::get().rip);
+
+        if (breakpoint != NULL && breakpoint->enabled && stop_at(breakpoint)) return;
+    }
+}
+
+// the stack slot of the return address of the function at rip, followed through the pushes, sub rsp and mov rbp, rsp from its entry
+// without a sized symbol or a prologue to follow it sits above the saved frame pointer, which needs a frame-pointer build
+unsigned long return_slot(struct user_regs_struct const& regs)
+{
+    vector<Instruction> here = DisassembleHandler::disassemble(regs.rip, 1);
+
+    if (!here.empty() && here[0].mnemonic == "ret") return regs.rsp;
+
+    Symbol const* symbol = SymbolHandler::find(regs.rip);
+
+    if (symbol == NULL || symbol->size == 0) return regs.rbp + 8;
+
+    unsigned long depth = 0;
+    long framed = -1;
+    bool followed = true;
+
+    for (auto instruction : DisassembleHandler::disassemble(symbol->address, 64)) {
+        if (instruction.address >= regs.rip) break;
+
+        string operands = instruction.op_str;
+        operands.erase(remove(operands.begin(), operands.end(), ' '), operands.end());
+        transform(operands.begin(), operands.end(), operands.begin(), ::tolower);
+
+        if (instruction.mnemonic == "push") {
+            depth += 8;
+        }
+        else if (instruction.mnemonic == "sub" && operands.compare(0, 4, "rsp,") == 0) {
+            try {
+                depth += stoul(operands.substr(4), nullptr, 0);
+            }
+            catch (exception const& e) {
+                followed = false;
+
+                break;
+            }
+        }
+        else if (instruction.mnemonic == "mov" && operands == "rbp,rsp") {
+            framed = depth;
+        }
+        else if (operands.compare(0, 4, "rsp,") == 0 || instruction.mnemonic == "pop" || instruction.mnemonic == "leave") {
+            // an epilogue on the way, past here only a frame pointer still tells where the slot is
+            followed = false;
+
+            break;
+        }
+    }
+
+    if (framed >= 0) return regs.rbp + framed;
+
+    return (followed ? regs.rsp + depth : regs.rbp + 8);
+}
+
+// true if address lies in a mapping with execute permission
+bool executable(unsigned long address)
+{
+    map<range_t, map_entry_t> vmmap;
+
+    if (load_maps(child, vmmap) < 0) return false;
+
+    for (auto& [range, entry] : vmmap) {
+        if (range.begin <= address && address < range.end) return (entry.permission & 0x01) != 0;
+    }
+
+    return false;
+}
+
+// resume with a single PTRACE_CONT until address is reached, through a temporary internal breakpoint or the user breakpoint already there
+// a non-empty condition keeps deeper recursive frames from stopping there, other breakpoints on the way still stop
+void run_to(string title, unsigned long address, string condition)
+{
+    Breakpoint* breakpoint = BreakpointHandler::find(address);
+    vector<int> ids;
+
+    run_target.borrowed = false;
+
+    if (breakpoint == NULL) {
+        ids = BreakpointHandler::insert({ address }, true);
+
+        if (ids.empty()) {
+            cerr << "** [ptrace] error, set breakpoint" << '\n';
+
+            return;
+        }
+    }
+    else if (!breakpoint->enabled) {
+        unsigned char int3 = 0xcc;
+
+        if (MemoryHandler::write(address, &int3, 1) != 1) {
+            cerr << "** [ptrace] error, set breakpoint" << '\n';
+
+            return;
+        }
+
+        breakpoint->enabled = true;
+        run_target.borrowed = true;
+    }
+
+    int id = (ids.empty() ? breakpoint->id : ids[0]);
+
+    run_target.active = true;
+    run_target.reached = false;
+    run_target.address = address;
+    run_target.program.clear();
+
+    if (!condition.empty()) {
+        ExpressionHandler::compile(condition, run_target.program);
+    }
+
+    cont();
+
+    run_target.active = false;
+
+    // taken out on every path, writing memory of a process that is gone just fails
+    if (!ids.empty()) {
+        TrampolineHandler::release(address);
+        BreakpointHandler::erase(ids);
+    }
+    else if (run_target.borrowed && (breakpoint = BreakpointHandler::get(id)) != NULL) {
+        unsigned char code = breakpoint->code;
+
+        MemoryHandler::write(address, &code, 1);
+        breakpoint->enabled = false;
+    }
+
+    if (WIFSTOPPED(wait_status) && run_target.reached && RegisterHandler::get().rip == address) {
+        print_location(title, address);
+    }
+}
+
+// seize and interrupt every thread, the process is stopped from the first PTRACE_INTERRUPT until all threads reported
+// the executable is parsed from /proc/pid/exe beforehand so the stop only covers the ptrace round trips
+void attach_program(pid_t pid)
+{
+    string exe = "/proc/" + to_string(pid) + "/exe";
+
+    char name[PATH_MAX] = {};
+    if (readlink(exe.c_str(), name, sizeof(name) - 1) < 0 || !load_executable(exe, pid)) {
+        cerr << "** [attach] error, cannot read the executable of pid " << pid << '\n';
+
+        return;
+    }
+
+    if (ptrace(PTRACE_SEIZE, pid, 0, TRACE_OPTIONS) < 0) {
+        cerr << "** [ptrace] error, seize pid " << pid << '\n';
+
+        SymbolHandler::unload();
+        DisassembleHandler::unload();
+        ElfHandler::unload();
+
+        return;
+    }
+
+    auto begin = chrono::steady_clock::now();
+
+    ptrace(PTRACE_INTERRUPT, pid, 0, 0);
+    waitpid(pid, &wait_status, __WALL);
+
+    ThreadHandler::clear();
+    ThreadHandler::add(pid, THREAD_STATE::THREAD_STOPPED);
+    ThreadHandler::select(pid);
+
+    // threads may still be created until every running thread is stopped, rescan until nothing new shows up
+    for (bool found = true; found;) {
+        found = false;
+
+        for (auto tid : list_threads(pid)) {
+            if (ThreadHandler::get(tid) != NULL) continue;
+
+            // a thread cloned by one that is already seized is attached to us on its own
+            ptrace(PTRACE_SEIZE, tid, 0, TRACE_OPTIONS);
+
+            if (ptrace(PTRACE_INTERRUPT, tid, 0, 0) < 0) continue;
+
+            int status = 0;
+            waitpid(tid, &status, __WALL);
+
+            Thread* thread = ThreadHandler::add(tid, THREAD_STATE::THREAD_STOPPED);
+
+            if (!WIFSTOPPED(status) || (status >> 16) != PTRACE_EVENT_STOP) {
+                thread->pending = true;
+                thread->status = status;
+            }
+
+            found = true;
+        }
+    }
+
+    // in non-stop mode only the main thread is held
+    if (ThreadHandler::non_stop()) {
+        ThreadHandler::resume_others();
+    }
+
+    chrono::duration<double, micro> stopped = chrono::steady_clock::now() - begin;
+
+    child = pid;
+    attached = true;
+    last_request = PTRACE_CONT;
+
+    attach_handlers(child);
+
+    map<range_t, map_entry_t> vmmap;
+    load_maps(child, vmmap);
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    current_status = STATUS::RUNNING;
+    cout << "** attached to pid " << dec << child << " '" << name << "', " << ThreadHandler::size() << " threads, " << vmmap.size() << " mappings, stopped in " << fixed << setprecision(1) << stopped.count() << " us" << '\n';
+
+    cout.copyfmt(state);
+
+    print_location("stopped", RegisterHandler::get().rip);
+}
+
+// breakpoints and debug registers are taken out before the threads run untraced again
+// a thread that stopped on an int3 but was never reported is walked back onto the original instruction
+void detach_program()
+{
+    auto begin = chrono::steady_clock::now();
+
+    ThreadHandler::stop_others();
+
+    for (auto thread : ThreadHandler::list()) {
+        struct user_regs_struct regs;
+
+        if (!thread->pending || !WIFSTOPPED(thread->status) || (thread->status >> 16) != 0 || WSTOPSIG(thread->status) != SIGTRAP) continue;
+
+        if (ptrace(PTRACE_GETREGS, thread->tid, 0, &regs) == 0 && BreakpointHandler::find(regs.rip - 1) != NULL) {
+            regs.rip -= 1;
+
+            ptrace(PTRACE_SETREGS, thread->tid, 0, &regs);
+        }
+    }
+
+    vector<int> ids;
+
+    for (auto breakpoint : BreakpointHandler::list()) {
+        ids.push_back(breakpoint->id);
+        TrampolineHandler::release(breakpoint->address);
+    }
+
+    BreakpointHandler::erase(ids);
+    WatchpointHandler::detach();
+    RegisterHandler::flush();
+
+    // a signal another thread stopped for is handed on, only our own traps are dropped
+    for (auto thread : ThreadHandler::list()) {
+        int signal = 0;
+
+        if (thread->pending && WIFSTOPPED(thread->status) && (thread->status >> 16) == 0 && WSTOPSIG(thread->status) != SIGTRAP) {
+            signal = WSTOPSIG(thread->status);
+        }
+
+        ptrace(PTRACE_DETACH, thread->tid, 0, signal);
+    }
+
+    chrono::duration<double, micro> stopped = chrono::steady_clock::now() - begin;
+
+    BreakpointHandler::clear();
+    MemoryHandler::detach();
+    RegisterHandler::detach();
+    SnapshotHandler::detach();
+    CheckpointHandler::clear();
+    DisassembleHandler::unload();
+    SymbolHandler::unload();
+    TrampolineHandler::detach();
+    ElfHandler::unload();
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    current_status = STATUS::NONE;
+    cout << "** detached from pid " << dec << child << ", " << ids.size() << " break points removed in " << fixed << setprecision(1) << stopped.count() << " us" << '\n';
+
+    if (filtered) {
+        cout << "** the seccomp filter stays in the program, its traced system calls fail with ENOSYS" << '\n';
+    }
+
+    cout.copyfmt(state);
+
+    child = -1;
+    attached = false;
+    filtered = false;
+    ThreadHandler::clear();
+}
+
+// the program is replaced by a new fork of the checkpoint, the checkpoint itself stays for the next restart
+// everything that follows the pid moves to the new process and the breakpoint table is rebased onto its memory
+void restart_program(Checkpoint const& checkpoint)
+{
+    auto begin = chrono::steady_clock::now();
+
+    RegisterHandler::flush();
+
+    MemoryHandler::attach(checkpoint.pid);
+    RegisterHandler::attach(checkpoint.pid);
+
+    pid_t pid = CheckpointHandler::fork(checkpoint.pid, checkpoint.pid);
+
+    if (pid < 0) {
+        MemoryHandler::attach(child);
+        RegisterHandler::attach(ThreadHandler::current());
+
+        cerr << "** [restart] error, cannot fork checkpoint " << checkpoint.id << '\n';
+
+        return;
+    }
+
+    size_t watchpoints = WatchpointHandler::list().size();
+
+    kill_program();
+
+    child = pid;
+    wait_status = checkpoint.status;
+    last_request = PTRACE_CONT;
+    forked.clear();
+
+    attach_handlers(child);
+    BreakpointHandler::rebase(checkpoint.breakpoints);
+
+    ThreadHandler::clear();
+    ThreadHandler::add(child, THREAD_STATE::THREAD_STOPPED);
+    select_thread(child);
+
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - begin;
+
+    ios state(nullptr);
+    state.copyfmt(cout);
+
+    cout << "** restarted checkpoint " << dec << checkpoint.id << " as pid " << child << " in " << fixed << setprecision(1) << elapsed.count() << " us";
+
+    if (watchpoints != 0) {
+        cout << ", " << watchpoints << " watch points removed";
+    }
+
+    cout << '\n';
+
+    cout.copyfmt(state);
+
+    print_location("stopped", RegisterHandler::get().rip);
+}
+
+int main(int argc, char* argv[])
+{
+    map<string, string> args = parse(argc, argv);
+
+    if (args.find("budget") != args.end()) {
+        unsigned long budget = 0;
+
+        if (!to_number(args["budget"], budget)) {
+            cerr << "** [args] error, '" << args["budget"] << "' is not a number" << '\n';
+
+            return 1;
+        }
+
+        DisassembleHandler::set_budget(budget);
+    }
+
+    if (args.find("syscalls") != args.end()) {
+        SyscallHandler::select({ args["syscalls"] });
+    }
+
+    if (args.find("pid") != args.end()) {
+        int pid = -1;
+
+        if (!to_number(args["pid"], pid)) {
+            cerr << "** [args] error, '" << args["pid"] << "' is not a number" << '\n';
+
+            return 1;
+        }
+
+        attach_program(pid);
+    }
+    else {
+        load_program(args);
+    }
+
+    fstream file;
+    if (args.find("script") != args.end()) {
+        file.open(args["script"]);
+    }
+
+    while (true) {
+        vector<string> command;
+
+        if (args.find("script") != args.end()) {
+            command = prompt("", file);
+
+            if (file.eof()) break;
+        }
+        else {
+            command = prompt("sdb> ", cin);
+        }
+
+        // a bad argument that slipped past the checks ends the command, not sdb with int3s left in the tracee
+        try {
+            switch (CommandHandler::check(command, current_status)) {
+                case COMMAND_TYPE::EXIT:
+                    // a launched program is killed with sdb, an attached one keeps running without our int3s
+                    if (attached) {
+                        detach_program();
+                    }
+
+                    return 0;
+                case COMMAND_TYPE::HELP:
+                    cout << "- attach pid: stop a running process and debug it, detach lets it go again" << '\n';
+                    cout << "- break {instruction-address | symbol[+offset]} [if expr]: add a break point, stop only when expr is not 0" << '\n';
+                    cout << "- break-file path: add a break point for every address or symbol listed in a file" << '\n';
+                    cout << "- checkpoint [list | delete checkpoint-id]: keep a stopped fork of the program to restart from, not for an attached process" << '\n';
+                    cout << "- condition {break-point-id} [expr]: set or clear the condition of a break point" << '\n';
+                    cout << "- cont: continue execution" << '\n';
+                    cout << "- counts: show how often every break point and tracepoint was hit" << '\n';
+                    cout << "- delete {break-point-id ... | all}: remove break points" << '\n';
+                    cout << "- detach: remove every break point and let the program run untraced" << '\n';
+                    cout << "- diff [snapshot-id]: show the memory changed since a snapshot (default the latest)" << '\n';
+                    cout << "- disable {break-point-id}: keep a break point but stop trapping on it" << '\n';
+                    cout << "- disasm addr: disassemble instructions in a file or a memory region" << '\n';
+                    cout << "- dump addr [length]: dump memory content" << '\n';
+                    cout << "- enable {break-point-id}: re-arm a disabled break point" << '\n';
+                    cout << "- exit: terminate the debugger" << '\n';
+                    cout << "- find pattern [region]: search memory for str:text, hex:de??ef or u8/u16/u32/u64:value[/mask], in every mapping, the ones named like region or begin-end" << '\n';
+                    cout << "- finish: run until the current function returns, past the prologue of a function without a symbol it needs a frame pointer" << '\n';
+                    cout << "- gcore [path]: write an ELF core of the program and keep it running (default core.pid)" << '\n';
+                    cout << "- get reg: get a single value from a register" << '\n';
+                    cout << "- getregs: show registers" << '\n';
+                    cout << "- getfpregs: show x87 / SSE / AVX registers" << '\n';
+                    cout << "- hbreak {instruction-address | symbol[+offset]}: add a break point in a debug register" << '\n';
+                    cout << "- help: show this message" << '\n';
+                    cout << "- ignore {break-point-id} count: pass a break point count times before stopping" << '\n';
+                    cout << "- list: list break points" << '\n';
+                    cout << "- load {path/to/a/program}: load a program" << '\n';
+                    cout << "- loadmem {address | symbol[+offset]} path: write the content of a file into memory, break points stay armed" << '\n';
+                    cout << "- next: step one instruction, stepping over calls" << '\n';
+                    cout << "- nonstop [on | off]: keep the other threads running while one is stopped (default off, all-stop)" << '\n';
+                    cout << "- patch {address | symbol[+offset]} hexbytes: write bytes into memory, break points stay armed" << '\n';
+                    cout << "- profile seconds hz [depth] [path]: sample rip and depth frames of every thread hz times a second, folded stacks go to path (default sdb.folded)" << '\n';
+                    cout << "- rbreak regex: add a break point on every function matching regex" << '\n';
+                    cout << "- restart [checkpoint-id]: replace the program with a new fork of a checkpoint (default the latest), not for an attached process" << '\n';
+                    cout << "- run: run the program" << '\n';
+                    cout << "- savemem {address | symbol[+offset]} length path: write a memory region to a file, without break points" << '\n';
+                    cout << "- sections: show elf sections, segments and build id" << '\n';
+                    cout << "- vmmap: show memory layout" << '\n';
+                    cout << "- set reg val: get a single value to a register" << '\n';
+                    cout << "- si: step into instruction" << '\n';
+                    cout << "- snapshot [list | delete snapshot-id]: keep a copy of the writable memory for diff" << '\n';
+                    cout << "- symbols [glob | /regex/]: list symbols" << '\n';
+                    cout << "- syscalls [name[,name ...] | log [count] | off]: trace the given system calls from the next launch, show their counts and latency" << '\n';
+                    cout << "- start: start the program and stop at the first instruction" << '\n';
+                    cout << "- tdump [count]: show the latest tracepoint records" << '\n';
+                    cout << "- thread tid: select the thread the other commands work on" << '\n';
+                    cout << "- threads: list the threads of the program" << '\n';
+                    cout << "- tpoint {instruction-address | symbol[+offset]} [expr, ...]: record up to 4 values at every hit and continue" << '\n';
+                    cout << "- trace {count | until address} [path [reg ...]]: single-step into a binary trace of rip and the given registers (default sdb.trace), bounded by one kernel single-step per instruction" << '\n';
+                    cout << "- until {address | symbol[+offset]}: run until address is reached" << '\n';
+                    cout << "- unwatch {watch-point-id}: remove a watch point or hardware break point" << '\n';
+                    cout << "- watch {address | symbol[+offset]} length [rw | w]: stop when memory is written or accessed" << '\n';
+
+                    break;
+                case COMMAND_TYPE::LIST: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    if (BreakpointHandler::size() == 0 && WatchpointHandler::list().empty()) {
+                        cout << "no break point" << '\n';
+                    }
+                    else {
+                        for (auto& watchpoint : WatchpointHandler::list()) {
+                            cout << 'w' << watchpoint.id << ": " << hex << watchpoint.address << dec;
+
+                            string symbol = SymbolHandler::symbolize(watchpoint.address);
+                            if (!symbol.empty()) {
+                                cout << " <" << symbol << ">";
+                            }
+
+                            if (watchpoint.type == WATCH_TYPE::WATCH_EXECUTE) {
+                                cout << " execute";
+                            }
+                            else {
+                                cout << " len " << (unsigned int)watchpoint.length << (watchpoint.type == WATCH_TYPE::WATCH_WRITE ? " w" : " rw");
+                            }
+
+                            if (watchpoint.slot == -1) {
+                                cout << " software";
+                            }
+                            else {
+                                cout << " dr" << watchpoint.slot;
+                            }
+
+                            cout << " hits " << watchpoint.hits << '\n';
+                        }
+
+                        for (auto breakpoint : BreakpointHandler::list()) {
+                            cout << breakpoint->id << ": " << hex << breakpoint->address << dec;
+
+                            string symbol = SymbolHandler::symbolize(breakpoint->address);
+                            if (!symbol.empty()) {
+                                cout << " <" << symbol << ">";
+                            }
+
+                            cout << " hits " << breakpoint->hits;
+
+                            if (breakpoint->ignore > 0) {
+                                cout << " ignore " << breakpoint->ignore;
+                            }
+
+                            if (breakpoint->trace) {
+                                cout << " trace";
+
+                                for (size_t i = 0; i < breakpoint->collect.size(); i++) {
+                                    cout << (i == 0 ? " " : ", ") << breakpoint->collect[i];
+                                }
+                            }
+
+                            if (!breakpoint->enabled) {
+                                cout << " disabled";
+                            }
+
+                            if (!breakpoint->condition.empty()) {
+                                cout << " if " << breakpoint->condition;
+                            }
+
+                            cout << '\n';
+                        }
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::LOAD:
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    args["program"] = command[1];
+
+                    args["program_arguments"] = "";
+                    for (size_t i = 1; i < command.size(); i++) {
+                        args["program_arguments"] += command[i];
+
+                        if (i != command.size() - 1) {
+                            args["program_arguments"] += " ";
+                        }
+                    }
+
+                    load_program(args);
+
+                    break;
+                case COMMAND_TYPE::RUN: {
+                    STATUS origin_status = current_status;
+                    current_status = STATUS::RUNNING;
+
+                    if (origin_status == current_status) {
+                        cout << "** program" << args["program"] << " is already running." << '\n';
+                    }
+
+                    if (origin_status != current_status) {
+                        cout << "** pid " << child << '\n';
+                    }
+
+                    cont();
+
+                    break;
+                }
+                case COMMAND_TYPE::SECTIONS: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    cout << hex << setfill('0');
+
+                    for (auto& section : ElfHandler::sections()) {
+                        if (section.name.empty()) continue;
+
+                        cout << setw(16) << right << section.header->sh_addr << '-' << setw(16) << right << (section.header->sh_addr + section.header->sh_size) << ' ';
+                        cout << setw(8) << right << section.header->sh_offset << ' ' << section.name << '\n';
+                    }
+
+                    for (auto p_header : ElfHandler::segments()) {
+                        if (p_header->p_type != PT_LOAD) continue;
+
+                        cout << setw(16) << right << p_header->p_vaddr << '-' << setw(16) << right << (p_header->p_vaddr + p_header->p_memsz) << ' ';
+                        cout << ((p_header->p_flags & PF_R) ? 'r' : '-') << ((p_header->p_flags & PF_W) ? 'w' : '-') << ((p_header->p_flags & PF_X) ? 'x' : '-') << " LOAD" << '\n';
+                    }
+
+                    string build_id = ElfHandler::build_id();
+                    cout << "build id: " << (build_id.empty() ? "none" : build_id) << '\n';
+
+                    // the addresses above are those of the file
+                    if (ElfHandler::bias() != 0) {
+                        cout << "load bias: 0x" << ElfHandler::bias() << '\n';
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::START: {
+                    current_status = STATUS::RUNNING;
+
+                    cout << "** pid " << child << '\n';
+
+                    break;
+                }
+                case COMMAND_TYPE::ATTACH: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    int pid = -1;
+
+                    if (!to_number(command[1], pid)) {
+                        cerr << "** [command] error, '" << command[1] << "' is not a number" << '\n';
+
+                        break;
+                    }
+
+                    attach_program(pid);
+
+                    break;
+                }
+                case COMMAND_TYPE::DETACH:
+                    detach_program();
+
+                    break;
+                case COMMAND_TYPE::BREAK: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    // break addr if expr, the condition is compiled before anything is written to the tracee
+                    string condition;
+                    vector<Operation> program;
+
+                    if (command.size() >= 3) {
+                        if (command[2] != "if" || command.size() < 4) {
+                            cerr << "** [command] error, expected 'if' condition" << '\n';
+
+                            break;
+                        }
+
+                        for (size_t i = 3; i < command.size(); i++) {
+                            condition += (i == 3 ? "" : " ") + command[i];
+                        }
+
+                        if (!ExpressionHandler::compile(condition, program)) break;
+                    }
+
+                    if (BreakpointHandler::find(target) != NULL) {
+                        cout << "breakpoint already exist" << '\n';
+
+                        break;
+                    }
+
+                    vector<int> ids = BreakpointHandler::insert({ target });
+
+                    if (ids.empty()) {
+                        cerr << "** [ptrace] error, set breakpoint" << '\n';
+
+                        break;
+                    }
+
+                    Breakpoint* breakpoint = BreakpointHandler::get(ids[0]);
+
+                    breakpoint->condition = condition;
+                    breakpoint->program = program;
+
+                    break;
+                }
+                case COMMAND_TYPE::COUNTS: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    vector<Breakpoint const*> breakpoints = BreakpointHandler::list();
+
+                    stable_sort(breakpoints.begin(), breakpoints.end(), [](Breakpoint const* lhs, Breakpoint const* rhs) {
+                        return lhs->hits > rhs->hits;
+                    });
+
+                    for (auto breakpoint : breakpoints) {
+                        cout << dec << setw(12) << setfill(' ') << right << breakpoint->hits << ' ';
+                        cout << setw(4) << breakpoint->id << ' ' << hex << setw(12) << breakpoint->address;
+
+                        string symbol = SymbolHandler::symbolize(breakpoint->address);
+                        if (!symbol.empty()) {
+                            cout << " <" << symbol << ">";
+                        }
+
+                        cout << '\n';
+                    }
+
+                    cout << "** " << dec << BreakpointHandler::recorded() << " trace records" << '\n';
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::CONDITION: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    int id = -1;
+                    Breakpoint* breakpoint = (to_number(command[1], id) ? BreakpointHandler::get(id) : NULL);
+
+                    if (breakpoint == NULL) {
+                        cout << "breakpoint not exist" << '\n';
+
+                        break;
+                    }
+
+                    // without an expression the breakpoint becomes unconditional again
+                    string condition;
+                    vector<Operation> program;
+
+                    for (size_t i = 2; i < command.size(); i++) {
+                        condition += (i == 2 ? "" : " ") + command[i];
+                    }
+
+                    if (!condition.empty() && !ExpressionHandler::compile(condition, program)) break;
+
+                    breakpoint->condition = condition;
+                    breakpoint->program = program;
+
+                    break;
+                }
+                case COMMAND_TYPE::BREAK_FILE:
+                case COMMAND_TYPE::RBREAK: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    vector<unsigned long> targets;
+
+                    if (command[0] == "rbreak") {
+                        for (auto symbol : SymbolHandler::match("/" + command[1] + "/")) {
+                            if (symbol->type == STT_FUNC && symbol->address != 0) {
+                                targets.push_back(symbol->address);
+                            }
+                        }
+                    }
+                    else {
+                        fstream f(command[1], ios::in);
+
+                        if (!f.is_open()) {
+                            cerr << "** [command] error, open " << command[1] << " fail" << '\n';
+
+                            break;
+                        }
+
+                        // one address or symbol[+offset] per line, '#' starts a comment
+                        string line;
+                        while (getline(f, line)) {
+                            line = line.substr(0, line.find('#'));
+
+                            stringstream ss(line);
+                            string expression;
+                            unsigned long target = 0;
+
+                            if (!(ss >> expression)) continue;
+
+                            if (SymbolHandler::resolve(expression, target)) {
+                                targets.push_back(target);
+                            }
+                            else {
+                                cerr << "** [command] error, unknown address or symbol " << expression << '\n';
+                            }
+                        }
+
+                        f.close();
+                    }
+
+                    vector<int> ids = BreakpointHandler::insert(targets);
+
+                    cout << "** " << ids.size() << " break points set" << '\n';
+
+                    break;
+                }
+                case COMMAND_TYPE::CONT:
+                    cont();
+
+                    break;
+                case COMMAND_TYPE::DELETE: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    vector<int> ids;
+
+                    if (command[1] == "all") {
+                        for (auto breakpoint : BreakpointHandler::list()) {
+                            ids.push_back(breakpoint->id);
+                        }
+                    }
+                    else {
+                        for (size_t i = 1; i < command.size(); i++) {
+                            int id = -1;
+
+                            if (!to_number(command[i], id)) {
+                                cerr << "** [command] error, '" << command[i] << "' is not a number" << '\n';
+                            }
+                            else if (BreakpointHandler::get(id) != NULL) {
+                                ids.push_back(id);
+                            }
+                            else {
+                                cout << "breakpoint " << id << " not exist" << '\n';
+                            }
+                        }
+                    }
+
+                    for (auto id : ids) {
+                        TrampolineHandler::release(BreakpointHandler::get(id)->address);
+                    }
+
+                    BreakpointHandler::erase(ids);
+
+                    break;
+                }
+                case COMMAND_TYPE::HBREAK: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    int id = WatchpointHandler::add(target, 1, WATCH_TYPE::WATCH_EXECUTE, false);
+
+                    if (id != -1) {
+                        cout << "** hardware breakpoint w" << id << " set" << '\n';
+
+                        break;
+                    }
+
+                    // out of debug registers, an int3 still works but changes the code bytes
+                    if (BreakpointHandler::find(target) != NULL) {
+                        cout << "breakpoint already exist" << '\n';
+
+                        break;
+                    }
+
+                    vector<int> ids = BreakpointHandler::insert({ target });
+
+                    if (ids.empty()) {
+                        cerr << "** [ptrace] error, set breakpoint" << '\n';
+                    }
+                    else {
+                        cout << "** no free debug register, software breakpoint " << ids[0] << " set instead" << '\n';
+                    }
+
+                    break;
+                }
+                case COMMAND_TYPE::WATCH: {
+                    if (command.size() < 3) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long length = strtoul(command[2].c_str(), NULL, 0);
+                    string mode = (command.size() >= 4 ? command[3] : "w");
+
+                    if (mode != "w" && mode != "rw") {
+                        cerr << "** [command] error, watch mode is rw or w" << '\n';
+
+                        break;
+                    }
+
+                    if (length != 1 && length != 2 && length != 4 && length != 8) {
+                        cerr << "** [command] error, watch length is 1, 2, 4 or 8" << '\n';
+
+                        break;
+                    }
+
+                    WATCH_TYPE type = (mode == "w" ? WATCH_TYPE::WATCH_WRITE : WATCH_TYPE::WATCH_ACCESS);
+                    int id = WatchpointHandler::add(target, length, type, true);
+
+                    if (id == -1) {
+                        cerr << "** [ptrace] error, no free or suitable debug register for a " << mode << " watchpoint" << '\n';
+
+                        break;
+                    }
+
+                    if (WatchpointHandler::get(id)->slot == -1) {
+                        cout << "** no free or suitable debug register, software watchpoint w" << id << " single-steps the program" << '\n';
+                    }
+                    else {
+                        cout << "** watchpoint w" << id << " set" << '\n';
+                    }
+
+                    break;
+                }
+                case COMMAND_TYPE::UNWATCH: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    string id = command[1];
+
+                    if (!id.empty() && id[0] == 'w') {
+                        id = id.substr(1);
+                    }
+
+                    int number = -1;
+
+                    if (!to_number(id, number) || !WatchpointHandler::remove(number)) {
+                        cout << "watchpoint not exist" << '\n';
+                    }
+
+                    break;
+                }
+                case COMMAND_TYPE::IGNORE: {
+                    if (command.size() < 3) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    int id = -1;
+                    Breakpoint* breakpoint = (to_number(command[1], id) ? BreakpointHandler::get(id) : NULL);
+
+                    if (breakpoint == NULL) {
+                        cout << "breakpoint not exist" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long count = 0;
+
+                    if (!to_number(command[2], count, 10)) {
+                        cerr << "** [command] error, '" << command[2] << "' is not a number" << '\n';
+
+                        break;
+                    }
+
+                    breakpoint->ignore = count;
+
+                    break;
+                }
+                case COMMAND_TYPE::TDUMP: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    unsigned long count = 20;
+
+                    if (command.size() >= 2 && !to_number(command[1], count, 10)) {
+                        cerr << "** [command] error, '" << command[1] << "' is not a number" << '\n';
+
+                        break;
+                    }
+
+                    vector<TraceRecord> records = BreakpointHandler::records(count);
+                    unsigned long sequence = BreakpointHandler::recorded() - records.size();
+
+                    for (auto& record : records) {
+                        Breakpoint const* breakpoint = BreakpointHandler::get(record.id);
+
+                        cout << dec << '#' << sequence++ << ' ' << record.id << ' ' << hex << record.address;
+
+                        string symbol = SymbolHandler::symbolize(record.address);
+                        if (!symbol.empty()) {
+                            cout << " <" << symbol << ">";
+                        }
+
+                        for (size_t i = 0; i < record.count; i++) {
+                            if (breakpoint != NULL && i < breakpoint->collect.size()) {
+                                cout << ' ' << breakpoint->collect[i] << " = ";
+                            }
+                            else {
+                                cout << " $" << dec << i << " = ";
+                            }
+
+                            if (record.valid & (1 << i)) {
+                                cout << "0x" << hex << record.values[i];
+                            }
+                            else {
+                                cout << "??";
+                            }
+                        }
+
+                        cout << '\n';
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::TPOINT: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    // tpoint addr expr, expr, ... the expressions are split on commas after the words are joined back
+                    string source;
+                    vector<string> collect;
+                    vector<vector<Operation>> collect_programs;
+
+                    for (size_t i = 2; i < command.size(); i++) {
+                        source += (i == 2 ? "" : " ") + command[i];
+                    }
+
+                    stringstream ss(source);
+                    string expression;
+                    bool valid = true;
+
+                    while (valid && getline(ss, expression, ',')) {
+                        expression.erase(0, expression.find_first_not_of(' '));
+                        expression.erase(expression.find_last_not_of(' ') + 1);
+
+                        if (expression.empty()) continue;
+
+                        collect_programs.push_back(vector<Operation>());
+                        collect.push_back(expression);
+
+                        valid = ExpressionHandler::compile(expression, collect_programs.back());
+                    }
+
+                    if (!valid) break;
+
+                    if (collect.size() > TraceRecord::MAX_VALUES) {
+                        cerr << "** [command] error, at most " << TraceRecord::MAX_VALUES << " values per tracepoint" << '\n';
+
+                        break;
+                    }
+
+                    if (BreakpointHandler::find(target) != NULL) {
+                        cout << "breakpoint already exist" << '\n';
+
+                        break;
+                    }
+
+                    vector<int> ids = BreakpointHandler::insert({ target });
+
+                    if (ids.empty()) {
+                        cerr << "** [ptrace] error, set breakpoint" << '\n';
+
+                        break;
+                    }
+
+                    Breakpoint* breakpoint = BreakpointHandler::get(ids[0]);
+
+                    breakpoint->trace = true;
+                    breakpoint->collect = collect;
+                    breakpoint->collect_programs = collect_programs;
+
+                    break;
+                }
+                case COMMAND_TYPE::ENABLE:
+                case COMMAND_TYPE::DISABLE: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    int id = -1;
+                    Breakpoint* breakpoint = (to_number(command[1], id) ? BreakpointHandler::get(id) : NULL);
+
+                    if (breakpoint == NULL) {
+                        cout << "breakpoint not exist" << '\n';
+
+                        break;
+                    }
+
+                    bool enabled = (command[0] == "enable");
+
+                    if (breakpoint->enabled == enabled) break;
+
+                    unsigned char code = (enabled ? 0xcc : breakpoint->code);
+
+                    if (MemoryHandler::write(breakpoint->address, &code, 1) != 1) {
+                        cerr << "** [ptrace] error, " << (enabled ? "enable" : "disable") << " breakpoint" << '\n';
+
+                        break;
+                    }
+
+                    breakpoint->enabled = enabled;
+
+                    break;
+                }
+                case COMMAND_TYPE::DISASM: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    if (!DisassembleHandler::contains(target)) {
+                        cerr << "** [disasm] error, address out of code" << '\n';
+
+                        cout.copyfmt(state);
+
+                        break;
+                    }
+
+                    for (auto instruction : DisassembleHandler::disassemble(target, 10)) {
+                        Symbol const* symbol = SymbolHandler::find(instruction.address);
+
+                        // label the first line and every symbol start, like objdump
+                        if (symbol != NULL && (instruction.address == symbol->address || instruction.address == target)) {
+                            cout << hex << setw(12) << setfill(' ') << right << instruction.address << " <" << SymbolHandler::symbolize(instruction.address) << ">:" << '\n';
+                        }
+
+                        cout << hex << setw(12) << setfill(' ') << right << instruction.address << ":";
+
+                        for (auto i = 0; i < 16; i++) {
+                            cout << " ";
+
+                            if (i < instruction.size) {
+                                cout << hex << setw(2) << setfill('0') << (unsigned int)instruction.bytes[i];
+                            }
+                            else {
+                                cout << "  ";
+                            }
+                        }
+
+                        cout << instruction.mnemonic << '\t' << instruction.op_str << '\n';
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::DUMP: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    map<range_t, map_entry_t> vmmap;
+                    load_maps(child, vmmap);
+
+                    bool mapped = false;
+                    for (auto element : vmmap) {
+                        if (target >= element.first.begin && target < element.first.end) {
+                            mapped = true;
+
+                            break;
+                        }
+                    }
+
+                    if (!mapped) {
+                        cerr << "** [dump] error, address not mapped" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long length = 80;
+                    if (command.size() >= 3 && !to_number(command[2], length)) {
+                        cerr << "** [command] error, '" << command[2] << "' is not a number" << '\n';
+
+                        break;
+                    }
+
+                    // read in bounded chunks so large dumps do not need one buffer of the full length
+                    vector<unsigned char> buffer(min(length, 1UL << 20));
+
+                    while (length > 0) {
+                        size_t chunk = min(length, (unsigned long)buffer.size());
+                        size_t n = MemoryHandler::read(target, buffer.data(), chunk);
+
+                        for (size_t i = 0; i < n; i += 16) {
+                            dump_code(target + i, buffer.data() + i, min(n - i, (size_t)16));
+                        }
+
+                        if (n < chunk) {
+                            cerr << "** [dump] error, address 0x" << hex << (target + n) << dec << " not readable" << '\n';
+
+                            break;
+                        }
+
+                        target += n;
+                        length -= n;
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::GET: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    RegisterDescriptor const* target_reg = find_register(command[1]);
+
+                    if (target_reg == NULL) {
+                        cerr << "** [reg] error, wrong reg name" << '\n';
+                    }
+                    else {
+                        unsigned long value = RegisterHandler::read(*target_reg);
+
+                        cout << command[1] << " = " << dec << value << hex << " (0x" << value << ")" << dec << '\n';
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::GETREGS: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    struct user_regs_struct const& regs = RegisterHandler::get();
+
+                    cout << hex;
+
+                    cout << "RAX " << setw(18) << left << regs.rax;
+                    cout << "RBX " << setw(18) << left << regs.rbx;
+                    cout << "RCX " << setw(18) << left << regs.rcx;
+                    cout << "RDX " << setw(18) << left << regs.rdx;
+
+                    cout << '\n';
+
+                    cout << "R8  " << setw(18) << left << regs.r8;
+                    cout << "R9  " << setw(18) << left << regs.r9;
+                    cout << "R10 " << setw(18) << left << regs.r10;
+                    cout << "R11 " << setw(18) << left << regs.r11;
+
+                    cout << '\n';
+
+                    cout << "R12 " << setw(18) << left << regs.r12;
+                    cout << "R13 " << setw(18) << left << regs.r13;
+                    cout << "R14 " << setw(18) << left << regs.r14;
+                    cout << "R15 " << setw(18) << left << regs.r15;
+
+                    cout << '\n';
+
+                    cout << "RDI " << setw(18) << left << regs.rdi;
+                    cout << "RSI " << setw(18) << left << regs.rsi;
+                    cout << "RBP " << setw(18) << left << regs.rbp;
+                    cout << "RSP " << setw(18) << left << regs.rsp;
+
+                    cout << '\n';
+
+                    cout << "RIP " << setw(18) << left << regs.rip;
+                    cout << "FLAGS " << setw(16) << setfill('0') << right << regs.eflags;
+
+                    cout << '\n';
+
+                    cout << dec;
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::GETFPREGS: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    struct user_fpregs_struct const& fpregs = RegisterHandler::fpregs();
+                    vector<unsigned char> const& xstate = RegisterHandler::xstate();
+
+                    // XSTATE_BV at offset 512 tells whether the AVX upper halves at offset 576 are in use
+                    bool avx = (xstate.size() >= 576 + 16 * 16 && (xstate[512] & 0x04));
+
+                    cout << hex;
+
+                    cout << "FCW " << setw(18) << left << fpregs.cwd;
+                    cout << "FSW " << setw(18) << left << fpregs.swd;
+                    cout << "MXCSR " << setw(16) << left << fpregs.mxcsr;
+
+                    cout << '\n';
+
+                    cout << right << setfill('0');
+
+                    for (auto i = 0; i < 16; i++) {
+                        cout << (avx ? "YMM" : "XMM") << setw(2) << setfill(' ') << left << dec << i << hex << right << setfill('0') << ' ';
+
+                        if (avx) {
+                            for (auto j = 3; j >= 0; j--) {
+                                cout << setw(8) << *(unsigned int*)(xstate.data() + 576 + i * 16 + j * 4);
+                            }
+                        }
+
+                        for (auto j = 3; j >= 0; j--) {
+                            cout << setw(8) << fpregs.xmm_space[i * 4 + j];
+                        }
+
+                        cout << '\n';
+                    }
+
+                    cout << dec;
+
+                    cout.copyfmt(state);
+
+                    break;
+                }
+                case COMMAND_TYPE::VMMAP: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    map<range_t, map_entry_t> vmmap;
+
+                    load_maps(child, vmmap);
+                    for (auto element : vmmap) {
+                        cout << element.second << '\n';
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
                 }
-                else if (command[1] == "rcx") {
-                    target_reg = &(regs.rcx);
+                case COMMAND_TYPE::SET: {
+                    if (command.size() < 3) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    RegisterDescriptor const* target_reg = find_register(command[1]);
+
+                    if (target_reg == NULL) {
+                        cerr << "** [reg] error, wrong reg name" << '\n';
+                    }
+                    else {
+                        unsigned long value = 0;
+                        bool valid = false;
+
+                        if (command[2].substr(0, 2) == "0b") {
+                            valid = to_number(command[2].substr(2), value, 2);
+                        }
+                        else if (command[2].substr(0, 2) == "0x") {
+                            valid = to_number(command[2], value, 16);
+                        }
+                        else {
+                            valid = to_number(command[2], value, 10);
+                        }
+
+                        if (!valid) {
+                            cerr << "** [command] error, '" << command[2] << "' is not a number" << '\n';
+                        }
+                        else {
+                            RegisterHandler::write(*target_reg, value);
+                        }
+                    }
+
+                    break;
                 }
-                else if (command[1] == "rdx") {
-                    target_reg = &(regs.rdx);
+                case COMMAND_TYPE::SYMBOLS: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    vector<Symbol const*> symbols = SymbolHandler::match(command.size() >= 2 ? command[1] : "*");
+
+                    for (auto symbol : symbols) {
+                        cout << hex << setw(16) << setfill('0') << right << symbol->address << ' ';
+                        cout << dec << setw(8) << setfill(' ') << right << symbol->size << ' ' << symbol->name << '\n';
+                    }
+
+                    cout << "** " << symbols.size() << " of " << SymbolHandler::size() << " symbols" << '\n';
+
+                    cout.copyfmt(state);
+
+                    break;
                 }
-                else if (command[1] == "r8") {
-                    target_reg = &(regs.r8);
+                case COMMAND_TYPE::SYSCALLS: {
+                    if (command.size() < 2) {
+                        SyscallHandler::report();
+
+                        break;
+                    }
+
+                    if (command[1] == "log") {
+                        unsigned long count = 20;
+
+                        if (command.size() >= 3 && !to_number(command[2], count)) {
+                            cerr << "** [command] error, '" << command[2] << "' is not a number" << '\n';
+
+                            break;
+                        }
+
+                        SyscallHandler::log(count);
+
+                        break;
+                    }
+
+                    if (command[1] == "off") {
+                        SyscallHandler::select({});
+                    }
+                    else if (!SyscallHandler::select(vector<string>(command.begin() + 1, command.end()))) {
+                        break;
+                    }
+
+                    cout << "** " << SyscallHandler::selected().size() << " system calls selected" << '\n';
+
+                    // the filter can only be installed before execvp, a program that has not run yet is launched again
+                    if (current_status == STATUS::LOADED && !attached) {
+                        kill(child, SIGKILL);
+
+                        while (waitpid(child, &wait_status, __WALL) == child && WIFSTOPPED(wait_status));
+
+                        unload_program();
+                        load_program(args);
+                    }
+                    else if (current_status == STATUS::RUNNING || attached) {
+                        cout << "** the selection takes effect on the next launch" << '\n';
+                    }
+
+                    break;
                 }
-                else if (command[1] == "r9") {
-                    target_reg = &(regs.r9);
+                case COMMAND_TYPE::FIND: {
+                    // matches after this many are only counted
+                    static constexpr size_t FIND_LIMIT = 1000;
+
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    if (!SearchHandler::compile(command[1])) break;
+
+                    SearchHandler::find(child, command.size() >= 3 ? command[2] : "", FIND_LIMIT);
+
+                    break;
                 }
-                else if (command[1] == "r10") {
-                    target_reg = &(regs.r10);
+                case COMMAND_TYPE::CHECKPOINT:
+                    // a fork of an attached process is not ours to run, and restart would kill the process for it
+                    if (command.size() < 2 && attached) {
+                        cerr << "** [checkpoint] error, not for an attached process" << '\n';
+                    }
+                    else if (command.size() < 2) {
+                        Checkpoint const* checkpoint = CheckpointHandler::take(child, ThreadHandler::current(), wait_status);
+
+                        if (checkpoint == NULL) break;
+
+                        cout << "** checkpoint " << checkpoint->id << ": pid " << checkpoint->pid;
+
+                        if (ThreadHandler::size() > 1) {
+                            cout << ", thread " << ThreadHandler::current() << " only, " << ThreadHandler::size() - 1 << " other threads are not in it";
+                        }
+
+                        cout << '\n';
+                    }
+                    else if (command[1] == "list") {
+                        CheckpointHandler::list();
+                    }
+                    else if (command[1] == "delete" && command.size() >= 3) {
+                        int id = -1;
+
+                        if (!to_number(command[2], id) || !CheckpointHandler::remove(id)) {
+                            cerr << "** [checkpoint] error, no checkpoint " << command[2] << '\n';
+                        }
+                    }
+                    else {
+                        cerr << "** [command] error, unknown checkpoint command" << '\n';
+                    }
+
+                    break;
+                case COMMAND_TYPE::RESTART: {
+                    // restart kills the program it replaces, an attached one is somebody else's
+                    if (attached) {
+                        cerr << "** [restart] error, not for an attached process" << '\n';
+
+                        break;
+                    }
+
+                    int id = -1;
+                    Checkpoint const* checkpoint = (command.size() < 2 || to_number(command[1], id) ? CheckpointHandler::get(id) : NULL);
+
+                    if (checkpoint == NULL) {
+                        cerr << "** [restart] error, no checkpoint" << (command.size() >= 2 ? " " + command[1] : "") << '\n';
+
+                        break;
+                    }
+
+                    restart_program(*checkpoint);
+
+                    break;
                 }
-                else if (command[1] == "r11") {
-                    target_reg = &(regs.r11);
+                case COMMAND_TYPE::SNAPSHOT:
+                    if (command.size() < 2) {
+                        SnapshotHandler::take();
+                    }
+                    else if (command[1] == "list") {
+                        SnapshotHandler::list();
+                    }
+                    else if (command[1] == "delete" && command.size() >= 3) {
+                        int id = -1;
+
+                        if (!to_number(command[2], id) || !SnapshotHandler::remove(id)) {
+                            cerr << "** [snapshot] error, no snapshot " << command[2] << '\n';
+                        }
+                    }
+                    else {
+                        cerr << "** [command] error, unknown snapshot command" << '\n';
+                    }
+
+                    break;
+                case COMMAND_TYPE::DIFF: {
+                    int id = -1;
+
+                    if (command.size() >= 2 && !to_number(command[1], id)) {
+                        cerr << "** [command] error, '" << command[1] << "' is not a number" << '\n';
+
+                        break;
+                    }
+
+                    SnapshotHandler::diff(id);
+
+                    break;
                 }
-                else if (command[1] == "r12") {
-                    target_reg = &(regs.r12);
+                case COMMAND_TYPE::GCORE: {
+                    // in non-stop mode the other threads are only stopped for as long as the core takes
+                    bool non_stop = ThreadHandler::non_stop();
+
+                    if (non_stop) {
+                        ThreadHandler::stop_others();
+                    }
+
+                    RegisterHandler::flush();
+
+                    vector<pid_t> threads = { ThreadHandler::current() };
+
+                    for (auto thread : ThreadHandler::list()) {
+                        if (thread->tid != ThreadHandler::current()) {
+                            threads.push_back(thread->tid);
+                        }
+                    }
+
+                    CoreHandler::dump(child, threads, WIFSTOPPED(wait_status) ? WSTOPSIG(wait_status) : 0, command.size() >= 2 ? command[1] : "core." + to_string(child));
+
+                    if (non_stop) {
+                        ThreadHandler::resume_others();
+                    }
+
+                    break;
                 }
-                else if (command[1] == "r13") {
-                    target_reg = &(regs.r13);
+                case COMMAND_TYPE::SAVEMEM: {
+                    if (command.size() < 4) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    // like gcore, the other threads of a non-stop session are stopped for as long as the transfer takes
+                    bool non_stop = ThreadHandler::non_stop();
+
+                    if (non_stop) {
+                        ThreadHandler::stop_others();
+                    }
+
+                    unsigned long length = 0;
+
+                    if (!to_number(command[2], length)) {
+                        cerr << "** [command] error, '" << command[2] << "' is not a number" << '\n';
+
+                        break;
+                    }
+
+                    TransferHandler::save(child, target, length, command[3]);
+
+                    if (non_stop) {
+                        ThreadHandler::resume_others();
+                    }
+
+                    break;
                 }
-                else if (command[1] == "r14") {
-                    target_reg = &(regs.r14);
+                case COMMAND_TYPE::LOADMEM: {
+                    if (command.size() < 3) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    bool non_stop = ThreadHandler::non_stop();
+
+                    if (non_stop) {
+                        ThreadHandler::stop_others();
+                    }
+
+                    TransferHandler::load(child, target, command[2]);
+
+                    if (non_stop) {
+                        ThreadHandler::resume_others();
+                    }
+
+                    break;
                 }
-                else if (command[1] == "r15") {
-                    target_reg = &(regs.r15);
+                case COMMAND_TYPE::PATCH: {
+                    if (command.size() < 3) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    // the bytes may be split over several arguments, "patch main 90 90 90"
+                    string bytes;
+
+                    for (size_t i = 2; i < command.size(); i++) {
+                        bytes += command[i];
+                    }
+
+                    bool non_stop = ThreadHandler::non_stop();
+
+                    if (non_stop) {
+                        ThreadHandler::stop_others();
+                    }
+
+                    TransferHandler::patch(child, target, bytes);
+
+                    if (non_stop) {
+                        ThreadHandler::resume_others();
+                    }
+
+                    break;
                 }
-                else if (command[1] == "rdi") {
-                    target_reg = &(regs.rdi);
+                case COMMAND_TYPE::NEXT: {
+                    struct user_regs_struct const& regs = RegisterHandler::get();
+                    vector<Instruction> instructions = DisassembleHandler::disassemble(regs.rip, 1);
+
+                    // only a call is stepped over, anything else (or code outside the program) is a single step
+                    if (!instructions.empty() && instructions[0].mnemonic.compare(0, 4, "call") == 0) {
+                        stringstream ss;
+                        ss << "rsp >= 0x" << hex << regs.rsp;
+
+                        run_to("next", regs.rip + instructions[0].size, ss.str());
+                    }
+                    else if (run(PTRACE_SINGLESTEP)) {
+                        check_breakpoint();
+                    }
+
+                    break;
                 }
-                else if (command[1] == "rsi") {
-                    target_reg = &(regs.rsi);
+                case COMMAND_TYPE::FINISH: {
+                    struct user_regs_struct const& regs = RegisterHandler::get();
+                    unsigned long slot = return_slot(regs);
+                    unsigned long target = 0;
+
+                    if (MemoryHandler::read(slot, &target, sizeof(target)) != sizeof(target)) {
+                        cerr << "** [ptrace] error, read return address" << '\n';
+
+                        break;
+                    }
+
+                    // a function without a frame pointer leaves rbp + 8 holding anything
+                    if (!executable(target)) {
+                        cerr << "** [finish] error, return address 0x" << hex << target << dec << " is not in executable memory, no frame pointer?" << '\n';
+
+                        break;
+                    }
+
+                    stringstream ss;
+                    ss << "rsp > 0x" << hex << slot;
+
+                    run_to("finish", target, ss.str());
+
+                    if (WIFSTOPPED(wait_status) && RegisterHandler::get().rip == target) {
+                        ios state(nullptr);
+                        state.copyfmt(cout);
+
+                        cout << "** returned rax = " << dec << RegisterHandler::get().rax << " (0x" << hex << RegisterHandler::get().rax << ")" << '\n';
+
+                        cout.copyfmt(state);
+                    }
+
+                    break;
                 }
-                else if (command[1] == "rbp") {
-                    target_reg = &(regs.rbp);
+                case COMMAND_TYPE::UNTIL: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    unsigned long target = 0;
+
+                    if (!SymbolHandler::resolve(command[1], target)) {
+                        cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                        break;
+                    }
+
+                    run_to("until", target, "");
+
+                    break;
                 }
-                else if (command[1] == "rsp") {
-                    target_reg = &(regs.rsp);
+                case COMMAND_TYPE::PROFILE: {
+                    if (command.size() < 3) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    if (WatchpointHandler::software()) {
+                        cerr << "** [profile] error, software watchpoints need single-stepping" << '\n';
+
+                        break;
+                    }
+
+                    // profile seconds hz [depth] [path]
+                    char* end = NULL;
+                    double seconds = strtod(command[1].c_str(), &end);
+                    unsigned long hz = 0;
+                    unsigned long depth = 8;
+                    string path = (command.size() > 4 ? command[4] : "sdb.folded");
+
+                    if (*end != '\0' || !to_number(command[2], hz) || (command.size() > 3 && !to_number(command[3], depth))) {
+                        cerr << "** [command] error, invalid duration, frequency or depth" << '\n';
+
+                        break;
+                    }
+
+                    if (seconds <= 0 || hz == 0 || hz > 1000000000) {
+                        cerr << "** [command] error, invalid duration or frequency" << '\n';
+
+                        break;
+                    }
+
+                    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+                    if (timer < 0) {
+                        cerr << "** [profile] error, timerfd_create" << '\n';
+
+                        break;
+                    }
+
+                    struct itimerspec interval = {};
+                    interval.it_interval.tv_sec = 1 / hz;
+                    interval.it_interval.tv_nsec = (1000000000 / hz) % 1000000000;
+                    interval.it_value = interval.it_interval;
+
+                    ProfileHandler::start(child);
+
+                    if (ThreadHandler::non_stop() && ThreadHandler::size() > 1) {
+                        cout << "** non-stop mode, only thread " << dec << ThreadHandler::current() << " is sampled" << '\n';
+                    }
+
+                    // a breakpoint under rip is stepped over first, PTRACE_CONT would execute its int3 again
+                    auto go = []() -> bool {
+                        Breakpoint const* breakpoint = BreakpointHandler::find(RegisterHandler::get().rip);
+
+                        if (breakpoint != NULL && breakpoint->enabled) {
+                            run(PTRACE_SINGLESTEP);
+
+                            if (!WIFSTOPPED(wait_status)) return false;
+
+                            TrampolineHandler::fixup();
+
+                            if (WSTOPSIG(wait_status) != SIGTRAP) return false;
+                        }
+
+                        resume(PTRACE_CONT);
+
+                        return true;
+                    };
+
+                    // stops the tracee runs into between two ticks arrive as SIGCHLD, so breakpoints are handled as soon as they hit
+                    sigset_t mask, previous;
+                    sigemptyset(&mask);
+                    sigaddset(&mask, SIGCHLD);
+                    sigprocmask(SIG_BLOCK, &mask, &previous);
+
+                    int events = signalfd(-1, &mask, SFD_CLOEXEC);
+                    struct pollfd fds[2] = { { timer, POLLIN, 0 }, { events, POLLIN, 0 } };
+
+                    bool running = go();
+                    vector<unsigned long> stack;
+                    stack.reserve(depth + 1);
+
+                    auto begin = chrono::steady_clock::now();
+                    auto deadline = begin + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+
+                    timerfd_settime(timer, 0, &interval, NULL);
+
+                    // only the register read and the frame walk happen while the tracee is stopped, symbols are resolved in report()
+                    while (running) {
+                        if (poll(fds, 2, -1) < 0) break;
+
+                        if (fds[1].revents & POLLIN) {
+                            struct signalfd_siginfo info;
+
+                            if (read(events, &info, sizeof(info)) != sizeof(info)) break;
+
+                            pid_t tid = 0;
+                            int status = 0;
+
+                            // signals are merged, so everything that stopped is collected, a stop already waited for finds nothing here
+                            while (running && (tid = waitpid(-1, &status, __WALL | WNOHANG)) > 0) {
+                                if (!dispatch(tid, status)) continue;
+
+                                if (!WIFSTOPPED(wait_status)) {
+                                    running = false;
+                                }
+                                else if (stray_interrupt()) {
+                                    // an interrupt that raced with a breakpoint is only delivered after it
+                                    resume(PTRACE_CONT);
+                                }
+                                else if (check_breakpoint()) {
+                                    running = false;
+                                }
+                                else {
+                                    running = go();
+                                }
+                            }
+
+                            if (!running) break;
+                        }
+
+                        if (!(fds[0].revents & POLLIN)) continue;
+
+                        unsigned long expirations = 0;
+
+                        if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations)) break;
+
+                        if (chrono::steady_clock::now() >= deadline) break;
+
+                        auto stop = chrono::steady_clock::now();
+
+                        ptrace(PTRACE_INTERRUPT, ThreadHandler::current(), 0, 0);
+                        wait_stop();
+
+                        if (!WIFSTOPPED(wait_status)) {
+                            running = false;
+
+                            break;
+                        }
+
+                        // anything else than our own interrupt stopped the tracee first, that interrupt comes in as the next event
+                        if (!stray_interrupt()) {
+                            if (check_breakpoint()) {
+                                running = false;
+
+                                break;
+                            }
+
+                            running = go();
+
+                            continue;
+                        }
+
+                        // in all-stop mode every thread stopped with the selected one, in non-stop mode the others run on unsampled
+                        for (auto thread : ThreadHandler::list()) {
+                            if (thread->state != THREAD_STATE::THREAD_STOPPED) continue;
+
+                            struct user_regs_struct regs;
+
+                            if (thread->tid == ThreadHandler::current()) {
+                                regs = RegisterHandler::get();
+                            }
+                            else if (ptrace(PTRACE_GETREGS, thread->tid, 0, &regs) != 0) {
+                                continue;
+                            }
+
+                            stack.clear();
+                            stack.push_back(regs.rip);
+
+                            // frame pointer chain: [rbp] is the caller's rbp, [rbp + 8] the return address
+                            unsigned long frame = regs.rbp;
+
+                            while (stack.size() < depth && frame != 0) {
+                                unsigned long record[2] = { 0, 0 };
+
+                                if (MemoryHandler::read(frame, record, sizeof(record)) != sizeof(record) || record[1] == 0) break;
+
+                                stack.push_back(record[1]);
+
+                                if (record[0] <= frame) break;
+
+                                frame = record[0];
+                            }
+
+                            ProfileHandler::sample(thread->tid, stack);
+                        }
+
+                        resume(PTRACE_CONT);
+
+                        ProfileHandler::stopped(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - stop).count());
+                    }
+
+                    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+                    close(timer);
+                    close(events);
+                    sigprocmask(SIG_SETMASK, &previous, NULL);
+
+                    // time is up with the tracee still running, stop it where it is
+                    if (running) {
+                        ptrace(PTRACE_INTERRUPT, ThreadHandler::current(), 0, 0);
+                        wait_stop();
+
+                        if (!WIFSTOPPED(wait_status) || (!stray_interrupt() && check_breakpoint())) {
+                            running = false;
+                        }
+                    }
+
+                    ProfileHandler::report(elapsed.count(), path);
+
+                    if (running) {
+                        print_location("profile stopped", RegisterHandler::get().rip);
+                    }
+
+                    break;
                 }
-                else if (command[1] == "rip") {
-                    target_reg = &(regs.rip);
+                case COMMAND_TYPE::NONSTOP: {
+                    if (command.size() < 2) {
+                        cout << "** non-stop mode is " << (ThreadHandler::non_stop() ? "on" : "off") << '\n';
+
+                        break;
+                    }
+
+                    bool non_stop = (command[1] == "on");
+
+                    if (non_stop == ThreadHandler::non_stop()) break;
+
+                    ThreadHandler::set_non_stop(non_stop);
+
+                    // switching over while the program is stopped lets the other threads go or holds them as well
+                    if (current_status == STATUS::RUNNING) {
+                        if (non_stop) {
+                            ThreadHandler::resume_others();
+                        }
+                        else {
+                            ThreadHandler::stop_others();
+                        }
+                    }
+
+                    break;
                 }
-                else if (command[1] == "flags") {
-                    target_reg = &(regs.eflags);
+                case COMMAND_TYPE::THREAD: {
+                    if (command.size() < 2) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    int tid = -1;
+                    Thread* thread = (to_number(command[1], tid) ? ThreadHandler::get(tid) : NULL);
+
+                    if (thread == NULL) {
+                        cout << "thread " << command[1] << " not exist" << '\n';
+
+                        break;
+                    }
+
+                    // a running thread (non-stop mode) is interrupted first, any other stop it made is reported on the next resume
+                    if (thread->state == THREAD_STATE::THREAD_RUNNING) {
+                        int status = 0;
+
+                        ptrace(PTRACE_INTERRUPT, tid, 0, 0);
+                        waitpid(tid, &status, __WALL);
+
+                        thread->state = THREAD_STATE::THREAD_STOPPED;
+
+                        if (!WIFSTOPPED(status) || (status >> 16) != PTRACE_EVENT_STOP || WSTOPSIG(status) != SIGTRAP) {
+                            thread->pending = true;
+                            thread->status = status;
+                        }
+                    }
+
+                    select_thread(tid);
+
+                    print_location("thread " + to_string(tid), RegisterHandler::get().rip);
+
+                    break;
                 }
+                case COMMAND_TYPE::THREADS: {
+                    ios state(nullptr);
+                    state.copyfmt(cout);
 
-                if (target_reg == NULL) {
-                    cerr << "** [reg] error, wrong reg name" << '\n';
+                    for (auto thread : ThreadHandler::list()) {
+                        cout << (thread->tid == ThreadHandler::current() ? "* " : "  ") << dec << setw(8) << left << thread->tid;
+
+                        if (thread->state == THREAD_STATE::THREAD_RUNNING) {
+                            cout << "running" << '\n';
+
+                            continue;
+                        }
+
+                        struct user_regs_struct regs;
+
+                        if (thread->tid == ThreadHandler::current()) {
+                            regs = RegisterHandler::get();
+                        }
+                        else if (ptrace(PTRACE_GETREGS, thread->tid, 0, &regs) != 0) {
+                            cout << "stopped" << '\n';
+
+                            continue;
+                        }
+
+                        cout << (thread->pending ? "pending" : "stopped") << " " << hex << regs.rip;
+
+                        string symbol = SymbolHandler::symbolize(regs.rip);
+                        if (!symbol.empty()) {
+                            cout << " <" << symbol << ">";
+                        }
+
+                        cout << '\n';
+                    }
+
+                    cout.copyfmt(state);
+
+                    break;
                 }
-                else {
-                    if (command[2].substr(0, 2) == "0b") {
-                        (*target_reg) = stoul(command[2], NULL, 2);
+                case COMMAND_TYPE::SI:
+                    if (run(PTRACE_SINGLESTEP)) {
+                        check_breakpoint();
                     }
-                    else if (command[2].substr(0, 2) == "0x") {
-                        (*target_reg) = stoul(command[2], NULL, 16);
+
+                    break;
+                case COMMAND_TYPE::TRACE: {
+                    if (command.size() < 2 || (command[1] == "until" && command.size() < 3)) {
+                        cerr << "** [command] error, argument not enough" << '\n';
+
+                        break;
+                    }
+
+                    // trace {count | until address} [path [reg ...]]
+                    unsigned long count = ULONG_MAX;
+                    unsigned long until = 0;
+                    size_t next = 2;
+
+                    if (command[1] == "until") {
+                        if (!SymbolHandler::resolve(command[2], until)) {
+                            cerr << "** [command] error, unknown address or symbol" << '\n';
+
+                            break;
+                        }
+
+                        next = 3;
                     }
                     else {
-                        (*target_reg) = stoul(command[2]);
+                        if (!to_number(command[1], count) || count == 0) {
+                            cerr << "** [trace] error, bad count '" << command[1] << "'" << '\n';
+
+                            break;
+                        }
                     }
 
-                    if (ptrace(PTRACE_SETREGS, child, 0, &regs) != 0) {
-                        cerr << "** [ptrace] error, set regs" << '\n';
+                    // the path always comes first, so a mistyped register never turns into a file name
+                    string path = (next < command.size() ? command[next] : "sdb.trace");
+                    vector<RegisterDescriptor const*> registers;
+                    bool valid = true;
+
+                    if (find_register(path) != NULL) {
+                        cerr << "** [trace] error, '" << path << "' is a register, the path comes first" << '\n';
+
+                        valid = false;
                     }
-                }
 
-                break;
-            }
-            case COMMAND_TYPE::SI:
-                restore_code();
+                    for (size_t i = next + 1; i < command.size(); i++) {
+                        RegisterDescriptor const* reg = find_register(command[i]);
 
-                ptrace(PTRACE_SINGLESTEP, child, 0, 0);
-                waitpid(child, &wait_status, 0);
+                        if (reg == NULL) {
+                            cerr << "** [trace] error, unknown register '" << command[i] << "'" << '\n';
 
-                check_breakpoint();
+                            valid = false;
+                        }
 
-                break;
-            case COMMAND_TYPE::UNKNOWN:
-                cerr << "** [command] error, status: ";
+                        registers.push_back(reg);
+                    }
 
-                switch (current_status) {
-                    case STATUS::NONE:
-                        cerr << "NONE, ";
+                    if (!valid) break;
 
-                        break;
-                    case STATUS::LOADED:
-                        cerr << "LOADED, ";
+                    if (!TraceHandler::open(path, registers, ElfHandler::bias())) {
+                        cerr << "** [trace] error, open " << path << " fail" << '\n';
 
                         break;
-                    case STATUS::RUNNING:
-                        cerr << "RUNNING, ";
+                    }
 
-                        break;
-                    default:
-                        break;
+                    // no prompt, no disassembly and no output per instruction, breakpoints are stepped over like any other code
+                    auto begin = chrono::steady_clock::now();
+
+                    for (unsigned long i = 0; i < count; i++) {
+                        TraceHandler::record(RegisterHandler::get());
+
+                        run(PTRACE_SINGLESTEP);
+
+                        if (!WIFSTOPPED(wait_status)) break;
+
+                        TrampolineHandler::fixup();
+
+                        if (WSTOPSIG(wait_status) != SIGTRAP || RegisterHandler::get().rip == until) break;
+                    }
+
+                    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+                    unsigned long records = TraceHandler::close();
+
+                    ios state(nullptr);
+                    state.copyfmt(cout);
+
+                    cout << "** traced " << records << " instructions in " << fixed << setprecision(3) << elapsed.count() << " s (";
+                    cout << setprecision(0) << (elapsed.count() > 0 ? records / elapsed.count() : 0) << " instructions/s) to " << path << '\n';
+
+                    cout.copyfmt(state);
+
+                    break;
                 }
+                case COMMAND_TYPE::UNKNOWN:
+                    cerr << "** [command] error, status: ";
 
-                cerr << "'" << command[0] << "' not allow" << '\n';
+                    switch (current_status) {
+                        case STATUS::NONE:
+                            cerr << "NONE, ";
 
-                break;
-            default:
-                break;
+                            break;
+                        case STATUS::LOADED:
+                            cerr << "LOADED, ";
+
+                            break;
+                        case STATUS::RUNNING:
+                            cerr << "RUNNING, ";
+
+                            break;
+                        default:
+                            break;
+                    }
+
+                    cerr << "'" << command[0] << "' not allow" << '\n';
+
+                    break;
+                default:
+                    break;
+            }
+        }
+        catch (exception const& e) {
+            cerr << "** [command] error, '" << command[0] << "' failed: " << e.what() << '\n';
         }
 
         if (WIFSTOPPED(wait_status) == 0) {
-            current_status = STATUS::NONE;
-
-            BreakpointHandler::clear();
-            instructions.clear();
+            unload_program();
 
             ios state(nullptr);
             state.copyfmt(cout);
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+
+#include "TraceHandler.h"
+#include "ElfHandler.h"
+#include "SymbolHandler.h"
+#include "DisassembleHandler.h"
+
+using namespace std;
+
+// turn a binary trace written by sdb's trace command into text, one instruction per line
+// usage: ./trace_decode {trace-file} [program]
+// with the traced program given, addresses are symbolized and instructions inside its executable segment disassembled
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " {trace-file} [program]" << '\n';
+
+        return EXIT_FAILURE;
+    }
+
+    ifstream f(argv[1], ios::in | ios::binary);
+
+    if (!f.is_open()) {
+        cerr << "** [trace] error, open " << argv[1] << " fail" << '\n';
+
+        return EXIT_FAILURE;
+    }
+
+    TraceHeader header;
+    f.read((char*)&header, sizeof(header));
+
+    if (!f || memcmp(header.magic, "SDBTRACE", sizeof(header.magic)) != 0 || header.version < 1 || header.version > 2) {
+        cerr << "** [trace] error, " << argv[1] << " is not an sdb trace" << '\n';
+
+        return EXIT_FAILURE;
+    }
+
+    vector<string> names;
+
+    for (unsigned int i = 0; i < header.count; i++) {
+        char name[TraceHandler::NAME_SIZE];
+        f.read(name, sizeof(name));
+
+        names.push_back(string(name, strnlen(name, sizeof(name))));
+    }
+
+    // a position-independent program ran at link-time addresses plus this, version 1 traces predate it
+    unsigned long bias = 0;
+
+    if (header.version >= 2) {
+        f.read((char*)&bias, sizeof(bias));
+    }
+
+    if (argc >= 3 && ElfHandler::load(argv[2])) {
+        ElfHandler::relocate(bias);
+        SymbolHandler::load();
+
+        Section const* text = ElfHandler::section(".text");
+        Elf64_Phdr const* p_header = (text != NULL ? ElfHandler::segment(text->header->sh_addr) : NULL);
+
+        if (p_header != NULL && (p_header->p_flags & PF_X)) {
+            unsigned long begin = p_header->p_vaddr;
+            unsigned long end = p_header->p_vaddr + p_header->p_filesz;
+
+            DisassembleHandler::load(ElfHandler::data(begin, end - begin), begin + bias, end + bias);
+        }
+    }
+
+    vector<unsigned long> record(1 + header.count);
+    unsigned long index = 0;
+
+    while (f.read((char*)record.data(), record.size() * sizeof(unsigned long))) {
+        cout << dec << setw(10) << setfill(' ') << right << index++ << ' ' << hex << setw(12) << record[0];
+
+        // only addresses inside the program's own segments, shared libraries are not loaded here
+        string symbol = (ElfHandler::loaded() && ElfHandler::segment(record[0] - bias) != NULL ? SymbolHandler::symbolize(record[0]) : "");
+        if (!symbol.empty()) {
+            cout << " <" << symbol << ">";
+        }
+
+        vector<Instruction> instructions = DisassembleHandler::disassemble(record[0], 1);
+
+        if (!instructions.empty()) {
+            cout << '\t' << instructions[0].mnemonic << '\t' << instructions[0].op_str;
+        }
+
+        for (unsigned int i = 0; i < header.count; i++) {
+            cout << '\t' << names[i] << '=' << hex << record[i + 1];
+        }
+
+        cout << '\n';
+    }
+
+    DisassembleHandler::unload();
+    SymbolHandler::unload();
+    ElfHandler::unload();
+
+    return EXIT_SUCCESS;
+}